@@ -11,6 +11,7 @@
 
 #include "anim.h"
 #include "drawing.h"
+#include "record.h"
 
 struct time cur_time;
 static int speed = 1;
@@ -22,7 +23,7 @@ init_anim (void)
   struct tm *tm;
   time_t t;
 
-  t = time (NULL);
+  t = record_clock (time (NULL));
   tm = gmtime (&t);
   cur_time.year = tm->tm_year + 1900;
   cur_time.month = tm->tm_mon + 1;
@@ -32,6 +33,37 @@ init_anim (void)
   set_to_localtime = 1;
 }
 
+int
+anim_speed (void)
+{
+  return speed;
+}
+
+void
+anim_set_speed (int new_speed)
+{
+  speed = new_speed;
+}
+
+void
+anim_step (struct time *t, int speed)
+{
+  switch (speed)
+    {
+    case 1:
+      t->m++;
+      if (t->m == 60)
+	t->m = 0, t->h++;
+      if (t->h == 24)
+	t->h = 0, t->day++;
+      break;
+
+    case 2:
+      t->day++;
+      break;
+    }
+}
+
 void
 do_anim (cairo_t *cairo_context, SDL_Event *event)
 {
@@ -60,17 +92,9 @@ do_anim (cairo_t *cairo_context, SDL_Event *event)
       break;
 
     case 1:
-      set_to_localtime = 0;
-      cur_time.m++;
-      if (cur_time.m == 60)
-	cur_time.m = 0, cur_time.h++;
-      if (cur_time.h == 24)
-	cur_time.h = 0, cur_time.day++;
-      break;
-
     case 2:
       set_to_localtime = 0;
-      cur_time.day++;
+      anim_step (&cur_time, speed);
       break;
     }
 }
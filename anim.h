@@ -20,4 +20,12 @@ extern struct time cur_time;
 extern void init_anim ();
 extern void do_anim (cairo_t *cairo_context, SDL_Event *event);
 
+/* Return the current animation speed: 0 follows the clock, 1 advances
+   one minute per frame, 2 advances one day per frame.  */
+extern int anim_speed (void);
+extern void anim_set_speed (int speed);
+
+/* Advance T by one frame at the given SPEED.  */
+extern void anim_step (struct time *t, int speed);
+
 #endif /* ANIM_H */
@@ -0,0 +1,150 @@
+/* Contour tracing - consistency test program.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sunrise.h"
+#include "contour.h"
+
+/* Trace the boundary of the lit region on a one degree grid, the same
+   way terminator.c does, with both marching_squares and
+   contour_trace_tiles, and check that the rings are the same point for
+   point.  When the whole border is lit, the first trace goes around
+   the map and a second one traces the dark hole from inside it; around
+   the equinoxes this happens for the twilights, so a year of dates
+   covers both cases.  */
+
+#define WIDTH	360
+#define HEIGHT	180
+#define BORDER	5
+
+static signed char rc[HEIGHT][WIDTH];
+static double rise[HEIGHT][WIDTH], set[HEIGHT][WIDTH];
+static double hours;
+static int failed;
+
+static int
+has_daylight (int x, int y, void *data __attribute__ ((unused)))
+{
+  double hm = hours;
+
+  if (x < 0)
+    x = 0;
+  if (x >= WIDTH)
+    x = WIDTH - 1;
+  if (y < 0)
+    y = 0;
+  if (y >= HEIGHT)
+    y = HEIGHT - 1;
+
+  if (rc[y][x])
+    return rc[y][x] > 0;
+
+  return ((hm > rise[y][x] && hm < set[y][x])
+	  || (hm + 24 > rise[y][x] && hm + 24 < set[y][x])
+	  || (hm - 24 > rise[y][x] && hm - 24 < set[y][x]));
+}
+
+static int
+inside (int x, int y, void *data)
+{
+  if (x <= -BORDER || x >= WIDTH + BORDER - 1
+      || y <= -BORDER || y >= HEIGHT + BORDER - 1)
+    return 0;
+
+  return has_daylight (x, y, data);
+}
+
+/* Trace from X, Y in both ways and compare the results.  The tiles
+   cover the grid and BORDER points around it, so that with inside the
+   outermost points are always dark.  Return what marching_squares
+   returned.  */
+static int
+compare (struct contour *ref, struct contour *c, int x, int y,
+	 contour_fn *fn, int border, const char *what)
+{
+  int ref_rc, c_rc, i, n;
+
+  contour_clear (ref);
+  contour_clear (c);
+  ref_rc = marching_squares (ref, WIDTH, HEIGHT, x, y, fn, NULL, 0);
+  c_rc = contour_trace_tiles (c, WIDTH, HEIGHT, -border, -border,
+			       WIDTH - 1 + border, HEIGHT - 1 + border,
+			       x < -border ? -border : x, y, fn, NULL);
+
+  if (c_rc == -1)
+    {
+      /* Only allowed if the ring leaves the rectangle.  */
+      for (i = 0; i < ref->n_pts; i++)
+	if (ref->pts[i].x < -border || ref->pts[i].x >= WIDTH - 1 + border
+	    || ref->pts[i].y < -border || ref->pts[i].y >= HEIGHT - 1 + border)
+	  return ref_rc;
+    }
+
+  n = ref->n_pts;
+  if (c_rc != ref_rc || c->n_pts != n
+      || memcmp (c->pts, ref->pts, n * sizeof (struct contour_point)) != 0)
+    {
+      printf ("==> %s: got %d with %d points, expected %d with %d points\n",
+	      what, c_rc, c->n_pts, ref_rc, n);
+      failed = 1;
+    }
+
+  return ref_rc;
+}
+
+int
+main (void)
+{
+  static const char *const names[3] = { "sun", "civil", "astro" };
+  int (*const fns[3]) (int, int, int, double, double, double *, double *) =
+    { sun_rise_set, civil_rise_set, astro_rise_set };
+  struct contour ref, c;
+  int level, month, day, h, x, y;
+
+  /* Use several threads even on a single processor.  */
+  setenv ("EARTHVIEW_THREADS", "16", 0);
+
+  memset (&ref, 0, sizeof (ref));
+  memset (&c, 0, sizeof (c));
+  for (level = 0; level < 3; level++)
+    {
+      int traces = 0, holes = 0;
+
+      for (month = 1; month <= 12; month++)
+	for (day = 1; day <= 22; day += 7)
+	  {
+	    for (y = 0; y < HEIGHT; y++)
+	      for (x = 0; x < WIDTH; x++)
+		rc[y][x] = fns[level] (2008, month, day,
+				       -179.5 + x, 89.5 - y,
+				       &rise[y][x], &set[y][x]);
+
+	    for (h = 0; h < 24 * 2; h++)
+	      {
+		hours = h / 2.0;
+		traces++;
+		if (!compare (&ref, &c, -10 * BORDER, HEIGHT / 2, inside,
+			      BORDER, "outer ring"))
+		  {
+		    holes++;
+		    compare (&ref, &c, 3, HEIGHT / 2, has_daylight, 0,
+			     "hole");
+		  }
+	      }
+	  }
+
+      printf ("==> %-5s %5d traces, %4d with a hole\n",
+	      names[level], traces, holes);
+    }
+
+  contour_free (&ref);
+  contour_free (&c);
+  printf (failed ? "==> FAILED\n" : "==> OK\n");
+  return failed;
+}
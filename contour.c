@@ -0,0 +1,649 @@
+/* Contour tracing.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "contour.h"
+#include "parallel.h"
+
+
+/* Marching squares implementation.  */
+
+enum dir {
+  UP, LT, DN, RT
+};
+
+/* Bit 3 = top left
+   bit 2 = top right
+   bit 1 = bottom left
+   bit 0 = bottom right.  */
+
+static const int next_square[16] = {
+  RT, /* | | | */		DN, /* | |.| */
+  LT, /* |.| | */		LT, /* |.|.| */
+  RT, /* | |'| */		DN, /* | |:| */
+  LT, /* |.|'| */		LT, /* |.|:| */
+  UP, /* |'| | */		UP, /* |'|.| */
+  UP, /* |:| | */		UP, /* |:|.| */
+  RT, /* |'|'| */		DN, /* |'|:| */
+  RT, /* |:|'| */		RT  /* |:|:| */
+};
+
+static inline int shift (enum dir d, int x)
+{
+  switch (d)
+    {
+    case UP: return (x & 0xC) >> 2;
+    case DN: return (x & 0x3) << 2;
+    case LT: return (x & 0xA) >> 1;
+    case RT: return (x & 0x5) << 1;
+    default: abort ();
+    }
+}
+
+
+/* Make room for N more points in C.  */
+static void
+contour_reserve (struct contour *c, int n)
+{
+  if (c->n_pts + n > c->max_pts)
+    {
+      c->max_pts = c->max_pts ? c->max_pts * 2 : 1024;
+      if (c->max_pts < c->n_pts + n)
+	c->max_pts = c->n_pts + n;
+      c->pts = realloc (c->pts, c->max_pts * sizeof (struct contour_point));
+      if (!c->pts)
+	abort ();
+    }
+}
+
+static void
+contour_add (struct contour *c, int x, int y)
+{
+  contour_reserve (c, 1);
+  c->pts[c->n_pts].x = x;
+  c->pts[c->n_pts].y = y;
+  c->n_pts++;
+}
+
+void
+contour_clear (struct contour *c)
+{
+  c->n_pts = c->n_rings = 0;
+}
+
+void
+contour_copy (struct contour *dest, const struct contour *src)
+{
+  if (dest->max_pts < src->n_pts)
+    {
+      dest->max_pts = src->max_pts;
+      dest->pts = realloc (dest->pts,
+			   dest->max_pts * sizeof (struct contour_point));
+      if (!dest->pts)
+	abort ();
+    }
+
+  memcpy (dest->pts, src->pts, src->n_pts * sizeof (struct contour_point));
+  memcpy (dest->rings, src->rings, src->n_rings * sizeof (int));
+  dest->n_pts = src->n_pts;
+  dest->n_rings = src->n_rings;
+}
+
+static void free_tiles (struct contour *c);
+
+void
+contour_free (struct contour *c)
+{
+  free_tiles (c);
+  free (c->pts);
+  free (c->grid);
+  free (c->tiles);
+  c->pts = NULL;
+  c->grid = NULL;
+  c->tiles = NULL;
+  c->n_pts = c->max_pts = c->n_rings = c->grid_size = c->n_tiles = 0;
+}
+
+#define BAD -151515151
+
+int
+marching_squares (struct contour *c, int width, int height, int x, int y,
+		  contour_fn *fn, void *data, int max_steps)
+{
+  int unknown_points = 15;
+  int inside_points = 0;
+  int hit = 0, startx = BAD, starty = BAD;
+  int went_inside = 0;
+  int n_pts = c->n_pts;
+
+  if (c->n_rings == MAX_RINGS)
+    abort ();
+
+  for (;;)
+    {
+      enum dir dir;
+
+      /* Bit 3 = top left
+         bit 2 = top right
+         bit 1 = bottom left
+         bit 0 = bottom right.  */
+      if ((unknown_points & 1) && fn (x + 1, y + 1, data))
+	inside_points |= 1;
+      if ((unknown_points & 2) && fn (x, y + 1, data))
+	inside_points |= 2;
+      if ((unknown_points & 4) && fn (x + 1, y, data))
+	inside_points |= 4;
+      if ((unknown_points & 8) && fn (x, y, data))
+	inside_points |= 8;
+
+      if (hit || (inside_points != 0 && inside_points != 15))
+        {
+	  if (x >= 0 && x < width && y >= 0 && y < height)
+	    went_inside = 1;
+
+	  if (!hit)
+	    startx = x, starty = y;
+	  else if (startx == x && starty == y)
+	    break;
+	  else if (max_steps && c->n_pts - n_pts == max_steps)
+	    {
+	      c->n_pts = n_pts;
+	      return -1;
+	    }
+
+	  contour_add (c, x, y);
+	  hit = 1;
+	}
+
+      dir = next_square[inside_points];
+      switch (dir)
+	{
+	case UP: y--; break;
+	case DN: y++; break;
+	case LT: x--; break;
+	case RT: x++; break;
+	}
+
+      unknown_points = shift (dir, 15) ^ 15;
+      inside_points = shift (dir, inside_points);
+    }
+
+  c->rings[c->n_rings++] = n_pts;
+  return went_inside;
+}
+
+void
+contour_add_ring (struct contour *c, const struct contour_point *pts, int n)
+{
+  if (c->n_rings == MAX_RINGS)
+    abort ();
+
+  if (c->n_pts + n > c->max_pts)
+    {
+      c->max_pts = c->n_pts + n > 1024 ? c->n_pts + n : 1024;
+      c->pts = realloc (c->pts, c->max_pts * sizeof (struct contour_point));
+      if (!c->pts)
+	abort ();
+    }
+
+  c->rings[c->n_rings++] = c->n_pts;
+  memcpy (c->pts + c->n_pts, pts, n * sizeof (struct contour_point));
+  c->n_pts += n;
+}
+
+void
+contour_next (int cell, int *x, int *y)
+{
+  switch (next_square[cell])
+    {
+    case UP: --*y; break;
+    case DN: ++*y; break;
+    case LT: --*x; break;
+    case RT: ++*x; break;
+    }
+}
+
+int
+contour_boundary_cell (int x, int y, contour_fn *fn, void *data)
+{
+  int inside_points = (fn (x, y, data) << 3) | (fn (x + 1, y, data) << 2)
+    | (fn (x, y + 1, data) << 1) | fn (x + 1, y + 1, data);
+
+  return inside_points != 0 && inside_points != 15
+    && inside_points != 6 && inside_points != 9;
+}
+
+
+/* Parallel contour extraction.  The rectangle is split in square tiles
+   that the threads handle independently.  Classifying every point
+   would cost much more than the sequential trace, which only looks at
+   the cells along the ring, so first only the top row and left column
+   of each tile are classified.  A ring can only enter a tile through
+   an edge along which the points are not all inside or all outside the
+   shape; the other tiles are skipped, unless the ring starts there.
+
+   The remaining tiles classify their other points and compute the
+   marching squares case of their cells.  In marching_squares, the case
+   alone determines which cell comes next, so each tile can also follow
+   the contour from every cell where it enters the tile, until it
+   leaves it.  These segments are then stitched together, starting from
+   the tile that holds the first cell of the ring, which is walked cell
+   by cell so that the ring can close where marching_squares closes it.
+   This gives exactly the same ring as the sequential trace.  */
+
+#define TILE_SIZE 16
+
+/* A part of the contour inside a tile.  PTS has the cells from the one
+   where the contour enters the tile; the cell after the last is
+   EXIT_X, EXIT_Y.  N_PTS is -1 if the contour never leaves the tile.  */
+struct segment
+{
+  int pts, n_pts;
+  short exit_x, exit_y;
+  char inside;
+};
+
+struct contour_tile
+{
+  /* The points from X0, Y0 (included) to X1, Y1 (excluded), relative
+     to the rectangle, and the cells from X0, Y0 to CX1, CY1.  */
+  int x0, y0, x1, y1;
+  int cx1, cy1;
+
+  /* Whether the points along each edge are not all the same.  */
+  char top, bottom, left, right;
+  char used;
+
+  /* The segment that starts at each cell on the edges of the tile, or
+     -1; see tile_entry.  */
+  int *entries;
+  int max_entries;
+
+  struct segment *segs;
+  int n_segs, max_segs;
+  struct contour_point *pts;
+  int n_pts, max_pts;
+};
+
+struct tiles
+{
+  int x0, y0, w, h;
+  int width, height;
+  int nx, ny;
+  int start;
+  contour_fn *fn;
+  void *data;
+  unsigned char *points;
+  unsigned char *cells;
+  struct contour_tile *tiles;
+};
+
+static void
+free_tiles (struct contour *c)
+{
+  int i;
+
+  for (i = 0; i < c->n_tiles; i++)
+    {
+      free (c->tiles[i].entries);
+      free (c->tiles[i].segs);
+      free (c->tiles[i].pts);
+    }
+}
+
+static inline int
+cell_case (const struct tiles *s, int x, int y)
+{
+  const unsigned char *top = s->points + y * s->w + x;
+  const unsigned char *bot = top + s->w;
+  return (top[0] << 3) | (top[1] << 2) | (bot[0] << 1) | bot[1];
+}
+
+static inline int
+classify (struct tiles *s, int x, int y)
+{
+  return s->points[y * s->w + x] = s->fn (s->x0 + x, s->y0 + y, s->data) != 0;
+}
+
+/* Return whether the points from X, Y to X + DX * N, Y + DY * N are
+   not all the same.  */
+static int
+mixed (const struct tiles *s, int x, int y, int dx, int dy, int n)
+{
+  const unsigned char *p = s->points + y * s->w + x;
+  int i, step = dy * s->w + dx;
+
+  for (i = 1; i <= n; i++)
+    if (p[i * step] != p[0])
+      return 1;
+  return 0;
+}
+
+/* Return where the segment for the cell X, Y on the edge of tile T is
+   stored.  */
+static inline int *
+tile_entry (struct contour_tile *t, int x, int y)
+{
+  int w = t->cx1 - t->x0, h = t->cy1 - t->y0;
+
+  if (y == t->y0)
+    return &t->entries[x - t->x0];
+  if (y == t->cy1 - 1)
+    return &t->entries[w + x - t->x0];
+  if (x == t->x0)
+    return &t->entries[2 * w + y - t->y0];
+  return &t->entries[2 * w + h + y - t->y0];
+}
+
+static inline struct contour_tile *
+tile_at (const struct tiles *s, int x, int y)
+{
+  return &s->tiles[(y / TILE_SIZE) * s->nx + x / TILE_SIZE];
+}
+
+static void
+classify_edges (int i, void *data)
+{
+  struct tiles *s = (struct tiles *) data;
+  struct contour_tile *t = &s->tiles[i];
+  int x, y;
+
+  for (x = t->x0; x < t->x1; x++)
+    classify (s, x, t->y0);
+  for (y = t->y0 + 1; y < t->y1; y++)
+    classify (s, t->x0, y);
+}
+
+static void
+classify_tile (int i, void *data)
+{
+  struct tiles *s = (struct tiles *) data;
+  struct contour_tile *t = &s->tiles[i];
+  int x, y;
+
+  /* The points on the far edges are classified by the next tiles.  */
+  t->top = t->y0 > 0 && mixed (s, t->x0, t->y0, 1, 0, t->cx1 - t->x0);
+  t->left = t->x0 > 0 && mixed (s, t->x0, t->y0, 0, 1, t->cy1 - t->y0);
+  t->bottom = t->y1 < s->h && mixed (s, t->x0, t->y1, 1, 0, t->cx1 - t->x0);
+  t->right = t->x1 < s->w && mixed (s, t->x1, t->y0, 0, 1, t->cy1 - t->y0);
+
+  t->used = i == s->start || t->top || t->bottom || t->left || t->right;
+  if (!t->used)
+    return;
+
+  for (y = t->y0 + 1; y < t->y1; y++)
+    for (x = t->x0 + 1; x < t->x1; x++)
+      classify (s, x, y);
+}
+
+/* Follow the contour from the cell X, Y of tile T, and add the segment
+   to the tile.  */
+static void
+add_segment (struct tiles *s, struct contour_tile *t, int x, int y)
+{
+  struct segment *seg;
+  int max_pts = (t->cx1 - t->x0) * (t->cy1 - t->y0);
+  int inside = 0;
+
+  if (*tile_entry (t, x, y) != -1)
+    return;
+
+  if (t->n_segs == t->max_segs)
+    {
+      t->max_segs = t->max_segs ? t->max_segs * 2 : 16;
+      t->segs = realloc (t->segs, t->max_segs * sizeof (struct segment));
+      if (!t->segs)
+	abort ();
+    }
+
+  *tile_entry (t, x, y) = t->n_segs;
+  seg = &t->segs[t->n_segs++];
+  seg->pts = t->n_pts;
+
+  while (x >= t->x0 && x < t->cx1 && y >= t->y0 && y < t->cy1)
+    {
+      if (t->n_pts - seg->pts == max_pts)
+	{
+	  seg->n_pts = -1;
+	  return;
+	}
+
+      if (t->n_pts == t->max_pts)
+	{
+	  t->max_pts = t->max_pts ? t->max_pts * 2 : 256;
+	  t->pts = realloc (t->pts, t->max_pts * sizeof (struct contour_point));
+	  if (!t->pts)
+	    abort ();
+	}
+
+      t->pts[t->n_pts].x = x + s->x0;
+      t->pts[t->n_pts].y = y + s->y0;
+      t->n_pts++;
+      if (x + s->x0 >= 0 && x + s->x0 < s->width
+	  && y + s->y0 >= 0 && y + s->y0 < s->height)
+	inside = 1;
+
+      switch (next_square[s->cells[y * s->w + x]])
+	{
+	case UP: y--; break;
+	case DN: y++; break;
+	case LT: x--; break;
+	case RT: x++; break;
+	}
+    }
+
+  seg->n_pts = t->n_pts - seg->pts;
+  seg->exit_x = x;
+  seg->exit_y = y;
+  seg->inside = inside;
+}
+
+static void
+extract_tile (int i, void *data)
+{
+  struct tiles *s = (struct tiles *) data;
+  struct contour_tile *t = &s->tiles[i];
+  int x, y;
+
+  t->n_segs = t->n_pts = 0;
+  if (!t->used)
+    return;
+
+  for (y = t->y0; y < t->cy1; y++)
+    {
+      const unsigned char *top = s->points + y * s->w;
+      const unsigned char *bot = top + s->w;
+      unsigned char *cell = s->cells + y * s->w;
+      for (x = t->x0; x < t->cx1; x++)
+	cell[x] = (top[x] << 3) | (top[x + 1] << 2) | (bot[x] << 1) | bot[x + 1];
+    }
+
+  /* The cells of the neighbouring tiles are computed at the same time,
+     so look at their points to find where the contour comes in.  The
+     neighbour on an edge that is not mixed may not have classified its
+     points, but the contour cannot come from there anyway.  */
+  memset (t->entries, -1,
+	  2 * (t->cx1 - t->x0 + t->cy1 - t->y0) * sizeof (int));
+  for (x = t->x0; x < t->cx1; x++)
+    {
+      if (t->top && next_square[cell_case (s, x, t->y0 - 1)] == DN)
+	add_segment (s, t, x, t->y0);
+      if (t->bottom && next_square[cell_case (s, x, t->cy1)] == UP)
+	add_segment (s, t, x, t->cy1 - 1);
+    }
+  for (y = t->y0; y < t->cy1; y++)
+    {
+      if (t->left && next_square[cell_case (s, t->x0 - 1, y)] == RT)
+	add_segment (s, t, t->x0, y);
+      if (t->right && next_square[cell_case (s, t->cx1, y)] == LT)
+	add_segment (s, t, t->cx1 - 1, y);
+    }
+}
+
+/* Set up the tiles for a rectangle of W x H points.  */
+static void
+init_tiles (struct contour *c, struct tiles *s)
+{
+  int i, j, n;
+
+  s->nx = (s->w - 2) / TILE_SIZE + 1;
+  s->ny = (s->h - 2) / TILE_SIZE + 1;
+  n = s->nx * s->ny;
+  if (c->n_tiles < n)
+    {
+      c->tiles = realloc (c->tiles, n * sizeof (struct contour_tile));
+      if (!c->tiles)
+	abort ();
+      memset (c->tiles + c->n_tiles, 0,
+	      (n - c->n_tiles) * sizeof (struct contour_tile));
+      c->n_tiles = n;
+    }
+
+  s->tiles = c->tiles;
+  for (j = 0; j < s->ny; j++)
+    for (i = 0; i < s->nx; i++)
+      {
+	struct contour_tile *t = &s->tiles[j * s->nx + i];
+
+	/* Every tile has at least one cell, so the last one may have
+	   one more row or column than the others.  */
+	t->x0 = i * TILE_SIZE;
+	t->y0 = j * TILE_SIZE;
+	t->x1 = i == s->nx - 1 ? s->w : t->x0 + TILE_SIZE;
+	t->y1 = j == s->ny - 1 ? s->h : t->y0 + TILE_SIZE;
+	t->cx1 = t->x1 < s->w ? t->x1 : s->w - 1;
+	t->cy1 = t->y1 < s->h ? t->y1 : s->h - 1;
+
+	n = 2 * (t->cx1 - t->x0 + t->cy1 - t->y0);
+	if (t->max_entries < n)
+	  {
+	    t->max_entries = n;
+	    t->entries = realloc (t->entries, n * sizeof (int));
+	    if (!t->entries)
+	      abort ();
+	  }
+      }
+}
+
+int
+contour_trace_tiles (struct contour *c, int width, int height,
+		     int x0, int y0, int x1, int y1,
+		     int x, int y, contour_fn *fn, void *data)
+{
+  struct tiles s;
+  struct contour_tile *start;
+  int max_steps, startx, starty, inside_points;
+  int went_inside = 0;
+  int n_pts = c->n_pts;
+
+  if (c->n_rings == MAX_RINGS)
+    abort ();
+
+  s.x0 = x0, s.y0 = y0;
+  s.w = x1 - x0 + 1, s.h = y1 - y0 + 1;
+  s.width = width, s.height = height;
+  s.fn = fn, s.data = data;
+  if (s.w < 2 || s.h < 2)
+    return -1;
+
+  /* Like marching_squares, move right until a cell that crosses the
+     contour.  This is the only part that calls FN from this thread.  */
+  x -= x0, y -= y0;
+  if (y < 0 || y >= s.h - 1)
+    return -1;
+  for (;; x++)
+    {
+      if (x < 0 || x >= s.w - 1)
+	return -1;
+      inside_points = (fn (x + x0, y + y0, data) << 3)
+	| (fn (x + x0 + 1, y + y0, data) << 2)
+	| (fn (x + x0, y + y0 + 1, data) << 1)
+	| fn (x + x0 + 1, y + y0 + 1, data);
+      if (inside_points != 0 && inside_points != 15)
+	break;
+    }
+
+  if (c->grid_size < 2 * s.w * s.h)
+    {
+      free (c->grid);
+      c->grid_size = 2 * s.w * s.h;
+      c->grid = malloc (c->grid_size);
+      if (!c->grid)
+	abort ();
+    }
+
+  s.points = c->grid;
+  s.cells = c->grid + s.w * s.h;
+  init_tiles (c, &s);
+  start = tile_at (&s, x, y);
+  s.start = start - s.tiles;
+
+  parallel_for (s.nx * s.ny, classify_edges, &s);
+  parallel_for (s.nx * s.ny, classify_tile, &s);
+  parallel_for (s.nx * s.ny, extract_tile, &s);
+
+  /* Now walk the cells, jumping over the tiles that do not have the
+     first cell.  No ring can visit more cells than there are in the
+     rectangle, so stop if the walk goes on for longer.  */
+  max_steps = (s.w - 1) * (s.h - 1);
+  startx = x, starty = y;
+  do
+    {
+      struct contour_tile *t;
+
+      if (x < 0 || x >= s.w - 1 || y < 0 || y >= s.h - 1)
+	goto fail;
+
+      t = tile_at (&s, x, y);
+      if (t != start)
+	{
+	  struct segment *seg;
+	  int j;
+
+	  /* A tile that was skipped cannot be reached, but be safe.  */
+	  if (!t->used || (j = *tile_entry (t, x, y)) == -1)
+	    goto fail;
+
+	  seg = &t->segs[j];
+	  if (seg->n_pts == -1
+	      || c->n_pts - n_pts + seg->n_pts > max_steps)
+	    goto fail;
+
+	  contour_reserve (c, seg->n_pts);
+	  memcpy (c->pts + c->n_pts, t->pts + seg->pts,
+		  seg->n_pts * sizeof (struct contour_point));
+	  c->n_pts += seg->n_pts;
+	  went_inside |= seg->inside;
+	  x = seg->exit_x, y = seg->exit_y;
+	  continue;
+	}
+
+      if (x + x0 >= 0 && x + x0 < width && y + y0 >= 0 && y + y0 < height)
+	went_inside = 1;
+      if (c->n_pts - n_pts == max_steps)
+	goto fail;
+
+      contour_add (c, x + x0, y + y0);
+      switch (next_square[s.cells[y * s.w + x]])
+	{
+	case UP: y--; break;
+	case DN: y++; break;
+	case LT: x--; break;
+	case RT: x++; break;
+	}
+    }
+  while (x != startx || y != starty);
+
+  c->rings[c->n_rings++] = n_pts;
+  return went_inside;
+
+ fail:
+  c->n_pts = n_pts;
+  return -1;
+}
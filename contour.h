@@ -0,0 +1,79 @@
+/* Contour tracing interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef CONTOUR_H
+#define CONTOUR_H
+
+/* A contour is kept as a list of points, so that it can be traced
+   before deciding whether to use it.  A new ring starts at each point
+   whose index is in RINGS.  */
+
+#define MAX_RINGS 4
+
+struct contour_point
+{
+  short x, y;
+};
+
+struct contour
+{
+  struct contour_point *pts;
+  int n_pts, max_pts;
+  int rings[MAX_RINGS];
+  int n_rings;
+
+  /* Scratch space for contour_trace_tiles.  */
+  unsigned char *grid;
+  int grid_size;
+  struct contour_tile *tiles;
+  int n_tiles;
+};
+
+/* A function returning whether the point X, Y is inside the shape.  */
+typedef int contour_fn (int x, int y, void *data);
+
+extern void contour_clear (struct contour *);
+
+/* Copy the points and rings of SRC into DEST.  */
+extern void contour_copy (struct contour *dest, const struct contour *src);
+extern void contour_free (struct contour *);
+
+/* Trace a contour with marching squares, starting from X, Y and moving
+   right until a cell that crosses the contour is found; add it to C as
+   a new ring.  Return 1 if the contour entered the WIDTH x HEIGHT map,
+   0 if it did not.  If MAX_STEPS is not zero and the trace does not come
+   back to its starting cell within that many steps, leave C unchanged
+   and return -1.  */
+extern int marching_squares (struct contour *c, int width, int height,
+			     int x, int y, contour_fn *fn, void *data,
+			     int max_steps);
+
+/* Add the N points at PTS to C as a new ring.  */
+extern void contour_add_ring (struct contour *c,
+			      const struct contour_point *pts, int n);
+
+/* Move X, Y to the cell that marching_squares visits after a cell
+   whose case is CELL.  The case has bit 3 set if the top left corner of
+   the cell is inside the shape, bit 2 for the top right corner, bit 1
+   for the bottom left and bit 0 for the bottom right.  */
+extern void contour_next (int cell, int *x, int *y);
+
+/* Return true if the cell whose top left corner is X, Y is crossed by
+   the contour exactly once.  */
+extern int contour_boundary_cell (int x, int y, contour_fn *fn, void *data);
+
+/* Same as marching_squares, but split the rectangle between X0, Y0 and
+   X1, Y1 (inclusive) in tiles, follow the contour within the tiles that
+   it can cross in parallel, and then stitch the pieces into a ring.
+   FN must be safe to call from several threads at the same time, and
+   is evaluated on the edges of every tile, so this only pays off with
+   many processors.  The result is the same as marching_squares's,
+   except that -1 is also returned if the contour leaves the rectangle.  */
+extern int contour_trace_tiles (struct contour *c, int width, int height,
+				int x0, int y0, int x1, int y1,
+				int x, int y, contour_fn *fn, void *data);
+
+#endif /* CONTOUR_H */
@@ -0,0 +1,175 @@
+/* Trigonometric functions in degrees - accuracy test program.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "degtrig.h"
+
+#define N 1000000
+
+/* Largest error allowed, in units in the last place.  */
+#define MAX_ULPS 3.0
+
+#define PI_L 3.141592653589793238462643383279502884L
+
+static double x[N], y[N], s[N], c[N], r[N];
+static int failed;
+
+static double
+ulps (double got, long double want)
+{
+  double w = (double) want;
+  double ulp = nextafter (fabs (w), INFINITY) - fabs (w);
+  if (w == 0.0)
+    ulp = nextafter (0.0, 1.0);
+  return fabsl ((long double) got - want) / ulp;
+}
+
+static void
+report (const char *name, double max_err, double where)
+{
+  printf ("==> %-14s max error %6.3f ulp at %.17g\n", name, max_err, where);
+  if (max_err > MAX_ULPS)
+    failed = 1;
+}
+
+static void
+check_sincos (const char *name, int array)
+{
+  double max_s = 0, max_c = 0, at_s = 0, at_c = 0;
+  int i;
+
+  if (array)
+    sincosd_array (x, s, c, N);
+  else
+    for (i = 0; i < N; i++)
+      sincosd (x[i], &s[i], &c[i]);
+
+  for (i = 0; i < N; i++)
+    {
+      /* Reduce to [-45, 45] exactly, then compute the reference in
+	 long double.  */
+      long double q = rintl (x[i] / 90.0L);
+      long double a = (x[i] - q * 90.0L) * (PI_L / 180.0L);
+      long double sa = sinl (a), ca = cosl (a), tmp;
+      long n = (long) q;
+      double e;
+
+      if (n & 1)
+	tmp = sa, sa = ca, ca = -tmp;
+      if (n & 2)
+	sa = -sa, ca = -ca;
+
+      e = ulps (s[i], sa);
+      if (e > max_s)
+	max_s = e, at_s = x[i];
+      e = ulps (c[i], ca);
+      if (e > max_c)
+	max_c = e, at_c = x[i];
+    }
+
+  printf ("%s:\n", name);
+  report ("sind", max_s, at_s);
+  report ("cosd", max_c, at_c);
+}
+
+static void
+check_acos (const char *name, int array)
+{
+  double max_err = 0, at = 0;
+  int i;
+
+  if (array)
+    acosd_array (y, r, N);
+  else
+    for (i = 0; i < N; i++)
+      r[i] = acosd (y[i]);
+
+  for (i = 0; i < N; i++)
+    {
+      double e = ulps (r[i], acosl (y[i]) * (180.0L / PI_L));
+      if (e > max_err)
+	max_err = e, at = y[i];
+    }
+
+  printf ("%s:\n", name);
+  report ("acosd", max_err, at);
+}
+
+static void
+check_atan2 (const char *name, int array)
+{
+  double max_err = 0, at = 0;
+  int i;
+
+  if (array)
+    atan2d_array (y, x, r, N);
+  else
+    for (i = 0; i < N; i++)
+      r[i] = atan2d (y[i], x[i]);
+
+  for (i = 0; i < N; i++)
+    {
+      double e = ulps (r[i], atan2l (y[i], x[i]) * (180.0L / PI_L));
+      if (e > max_err)
+	max_err = e, at = y[i] / x[i];
+    }
+
+  printf ("%s:\n", name);
+  report ("atan2d", max_err, at);
+}
+
+int
+main (void)
+{
+  int i;
+
+  srand (42);
+  for (i = 0; i < N; i++)
+    {
+      /* Mostly angles within a few turns, and some multiples of 15
+	 degrees which must come out exact or nearly so.  */
+      if (i % 16 == 0)
+	x[i] = (rand () % 97 - 48) * 15.0;
+      else
+	x[i] = (rand () / (double) RAND_MAX - 0.5) * 2000.0;
+
+      y[i] = rand () / (double) RAND_MAX * 2.0 - 1.0;
+    }
+
+  check_sincos ("Scalar", 0);
+  check_sincos ("Vector", 1);
+  check_acos ("Scalar", 0);
+  check_acos ("Vector", 1);
+
+  for (i = 0; i < N; i++)
+    x[i] = (x[i] / 1000.0) * (i % 3 == 0 ? 1e-3 : 1.0);
+  check_atan2 ("Scalar", 0);
+  check_atan2 ("Vector", 1);
+
+  /* The sign of zero matters when dividing by cosd (90.0), like
+     calc_sun_rise_set does at the poles.  */
+  if (sind (180.0) != 0.0 || cosd (90.0) != 0.0 || sind (-540.0) != 0.0
+      || signbit (sind (180.0)) || signbit (cosd (90.0))
+      || signbit (cosd (-90.0)) || signbit (cosd (270.0)))
+    {
+      printf ("==> Multiples of 90 degrees are not exact!\n");
+      failed = 1;
+    }
+
+  x[0] = 90.0, x[1] = 180.0, x[2] = -90.0, x[3] = 270.0;
+  sincosd_array (x, s, c, 4);
+  if (signbit (c[0]) || signbit (s[1]) || signbit (c[2]) || signbit (c[3]))
+    {
+      printf ("==> Vector multiples of 90 degrees have the wrong sign!\n");
+      failed = 1;
+    }
+
+  printf (failed ? "==> FAILED\n" : "==> OK\n");
+  return failed;
+}
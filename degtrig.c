@@ -0,0 +1,227 @@
+/* Trigonometric functions in degrees - array versions.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "degtrig.h"
+
+/* The array versions use GCC's generic vectors, which are compiled to
+   whatever vector instructions the target has.  The algorithms are the
+   same as the scalar ones in degtrig.h, with branches replaced by
+   selects.  Leftover elements go through a temporary vector.  */
+
+#ifdef __AVX__
+#define VLEN 4
+#else
+#define VLEN 2
+#endif
+
+typedef double vdouble __attribute__ ((vector_size (VLEN * sizeof (double))));
+typedef int64_t vlong __attribute__ ((vector_size (VLEN * sizeof (double))));
+
+/* Adding and subtracting this rounds to an integer, in round-to-nearest
+   mode and if the absolute value is less than 2^51.  */
+#define ROUND_MAGIC 6755399441055744.0
+
+#define SPLAT(x) ((vdouble) { } + (x))
+#define SIGN_BIT ((vlong) { } + INT64_MIN)
+
+static inline vdouble
+vselect (vlong mask, vdouble a, vdouble b)
+{
+  return (vdouble) ((mask & (vlong) a) | (~mask & (vlong) b));
+}
+
+static inline vdouble
+vabs (vdouble x)
+{
+  return (vdouble) ((vlong) x & ~SIGN_BIT);
+}
+
+/* Give X the sign of the corresponding element of Y.  */
+static inline vdouble
+vcopysign (vdouble x, vdouble y)
+{
+  return (vdouble) (((vlong) x & ~SIGN_BIT) | ((vlong) y & SIGN_BIT));
+}
+
+static inline vdouble
+vsqrt (vdouble x)
+{
+  vdouble r;
+  int i;
+  for (i = 0; i < VLEN; i++)
+    r[i] = sqrt (x[i]);
+  return r;
+}
+
+static inline vdouble
+vload (const double *p)
+{
+  vdouble v;
+  memcpy (&v, p, sizeof (v));
+  return v;
+}
+
+static inline void
+vstore (double *p, vdouble v)
+{
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+vsincosd (vdouble x, vdouble *s, vdouble *c)
+{
+  vdouble q = (x * SPLAT (1.0 / 90.0) + SPLAT (ROUND_MAGIC))
+    - SPLAT (ROUND_MAGIC);
+  vdouble r = x - q * SPLAT (90.0);
+  vdouble t = r * SPLAT (DEG_RAD), z = t * t;
+  vlong n = __builtin_convertvector (q, vlong);
+  vlong odd = (n & 1) != 0;
+  vlong neg = (n & 2) != 0;
+  vdouble sq, cq;
+
+  vdouble sr = t + t * z * (SPLAT (DEGTRIG_S1) + z * (SPLAT (DEGTRIG_S2)
+	    + z * (SPLAT (DEGTRIG_S3) + z * (SPLAT (DEGTRIG_S4)
+	    + z * (SPLAT (DEGTRIG_S5) + z * SPLAT (DEGTRIG_S6))))));
+  vdouble cr = SPLAT (1.0) - SPLAT (0.5) * z
+    + z * z * (SPLAT (DEGTRIG_C1) + z * (SPLAT (DEGTRIG_C2)
+	    + z * (SPLAT (DEGTRIG_C3) + z * (SPLAT (DEGTRIG_C4)
+	    + z * (SPLAT (DEGTRIG_C5) + z * SPLAT (DEGTRIG_C6))))));
+
+  sq = vselect (odd, cr, sr);
+  cq = vselect (odd, SPLAT (0.0) - sr, cr);
+  *s = vselect (neg, SPLAT (0.0) - sq, sq);
+  *c = vselect (neg, SPLAT (0.0) - cq, cq);
+}
+
+static inline vdouble
+vasin_kernel (vdouble x, vdouble z)
+{
+  vdouble p = z * (SPLAT (DEGTRIG_PS0) + z * (SPLAT (DEGTRIG_PS1)
+	    + z * (SPLAT (DEGTRIG_PS2) + z * (SPLAT (DEGTRIG_PS3)
+	    + z * (SPLAT (DEGTRIG_PS4) + z * SPLAT (DEGTRIG_PS5))))));
+  vdouble q = SPLAT (1.0) + z * (SPLAT (DEGTRIG_QS1)
+	    + z * (SPLAT (DEGTRIG_QS2) + z * (SPLAT (DEGTRIG_QS3)
+	    + z * SPLAT (DEGTRIG_QS4))));
+  return x + x * (p / q);
+}
+
+static inline vdouble
+vacosd (vdouble x)
+{
+  vdouble a = vabs (x);
+  vlong small = a <= SPLAT (0.5);
+  vdouble z, u, r;
+
+  /* For small |x| compute asin of x itself, otherwise of
+     sqrt ((1 - |x|) / 2).  */
+  z = vselect (small, x * x, SPLAT (0.5) * (SPLAT (1.0) - a));
+  u = vselect (small, x, vsqrt (z));
+  r = SPLAT (RAD_DEG) * vasin_kernel (u, z);
+
+  return vselect (small, SPLAT (90.0) - r,
+		  vselect (x < SPLAT (0.0), SPLAT (180.0) - SPLAT (2.0) * r,
+			   SPLAT (2.0) * r));
+}
+
+static inline vdouble
+vatan2d (vdouble y, vdouble x)
+{
+  vdouble ax = vabs (x), ay = vabs (y);
+  vlong swap = ay > ax;
+  vdouble num = vselect (swap, ax, ay);
+  vdouble den = vselect (swap, ay, ax);
+  vdouble t, u, z, w, s1, s2, r;
+  vlong big;
+
+  /* Avoid 0/0; the result is then 0 before fixing the quadrant.  */
+  den = vselect (den == SPLAT (0.0), SPLAT (1.0), den);
+  t = num / den;
+  big = t > SPLAT (DEGTRIG_TAN_PI_8);
+  u = vselect (big, (t - SPLAT (1.0)) / (t + SPLAT (1.0)), t);
+
+  z = u * u;
+  w = z * z;
+  s1 = z * (SPLAT (DEGTRIG_AT0) + w * (SPLAT (DEGTRIG_AT2)
+	    + w * (SPLAT (DEGTRIG_AT4) + w * (SPLAT (DEGTRIG_AT6)
+	    + w * (SPLAT (DEGTRIG_AT8) + w * SPLAT (DEGTRIG_AT10))))));
+  s2 = w * (SPLAT (DEGTRIG_AT1) + w * (SPLAT (DEGTRIG_AT3)
+	    + w * (SPLAT (DEGTRIG_AT5) + w * (SPLAT (DEGTRIG_AT7)
+	    + w * SPLAT (DEGTRIG_AT9)))));
+  r = SPLAT (RAD_DEG) * (u - u * (s1 + s2));
+
+  r = vselect (big, SPLAT (45.0) + r, r);
+  r = vselect (swap, SPLAT (90.0) - r, r);
+  r = vselect (((vlong) x & SIGN_BIT) != 0, SPLAT (180.0) - r, r);
+  return vcopysign (r, y);
+}
+
+void
+sincosd_array (const double *x, double *s, double *c, int n)
+{
+  double tmp[3][VLEN];
+  vdouble vs, vc;
+  int i;
+
+  for (i = 0; i + VLEN <= n; i += VLEN)
+    {
+      vsincosd (vload (x + i), &vs, &vc);
+      vstore (s + i, vs);
+      vstore (c + i, vc);
+    }
+
+  if (i < n)
+    {
+      memset (tmp, 0, sizeof (tmp));
+      memcpy (tmp[0], x + i, (n - i) * sizeof (double));
+      vsincosd (vload (tmp[0]), &vs, &vc);
+      vstore (tmp[1], vs);
+      vstore (tmp[2], vc);
+      memcpy (s + i, tmp[1], (n - i) * sizeof (double));
+      memcpy (c + i, tmp[2], (n - i) * sizeof (double));
+    }
+}
+
+void
+acosd_array (const double *x, double *r, int n)
+{
+  double tmp[VLEN];
+  int i;
+
+  for (i = 0; i + VLEN <= n; i += VLEN)
+    vstore (r + i, vacosd (vload (x + i)));
+
+  if (i < n)
+    {
+      memset (tmp, 0, sizeof (tmp));
+      memcpy (tmp, x + i, (n - i) * sizeof (double));
+      vstore (tmp, vacosd (vload (tmp)));
+      memcpy (r + i, tmp, (n - i) * sizeof (double));
+    }
+}
+
+void
+atan2d_array (const double *y, const double *x, double *r, int n)
+{
+  double tmp[2][VLEN];
+  int i;
+
+  for (i = 0; i + VLEN <= n; i += VLEN)
+    vstore (r + i, vatan2d (vload (y + i), vload (x + i)));
+
+  if (i < n)
+    {
+      memset (tmp, 0, sizeof (tmp));
+      memcpy (tmp[0], y + i, (n - i) * sizeof (double));
+      memcpy (tmp[1], x + i, (n - i) * sizeof (double));
+      vstore (tmp[0], vatan2d (vload (tmp[0]), vload (tmp[1])));
+      memcpy (r + i, tmp[0], (n - i) * sizeof (double));
+    }
+}
@@ -0,0 +1,217 @@
+/* Trigonometric functions in degrees.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef DEGTRIG_H
+#define DEGTRIG_H
+
+#include <math.h>
+
+#define DEG_RAD         (M_PI / 180.0)
+#define RAD_DEG         (180.0 / M_PI)
+
+/* Arguments in degrees are reduced to [-45, 45] by subtracting a multiple
+   of 90, which is exact, so that for example sind (180.0) is exactly zero
+   and no precision is lost for large angles.  Only then the angle is
+   converted to radians and passed to the polynomial kernels.  The
+   polynomials are the ones from fdlibm; with the conversion between
+   degrees and radians the results are within three ulps of the exact
+   ones (see degtrig-test), and -ffast-math is not needed.  */
+
+/* Minimax polynomials for sin and cos on [-pi/4, pi/4].  */
+#define DEGTRIG_S1	-1.66666666666666324348e-01
+#define DEGTRIG_S2	 8.33333333332248946124e-03
+#define DEGTRIG_S3	-1.98412698298579493134e-04
+#define DEGTRIG_S4	 2.75573137070700676789e-06
+#define DEGTRIG_S5	-2.50507602534068634195e-08
+#define DEGTRIG_S6	 1.58969099521155010221e-10
+
+#define DEGTRIG_C1	 4.16666666666666019037e-02
+#define DEGTRIG_C2	-1.38888888888741095749e-03
+#define DEGTRIG_C3	 2.48015872894767294178e-05
+#define DEGTRIG_C4	-2.75573143513906633035e-07
+#define DEGTRIG_C5	 2.08757232129817482790e-09
+#define DEGTRIG_C6	-1.13596475577881948265e-11
+
+/* Rational approximation of asin (x) - x on [0, 0.5].  */
+#define DEGTRIG_PS0	 1.66666666666666657415e-01
+#define DEGTRIG_PS1	-3.25565818622400915405e-01
+#define DEGTRIG_PS2	 2.01212532134862925881e-01
+#define DEGTRIG_PS3	-4.00555345006794114027e-02
+#define DEGTRIG_PS4	 7.91534994289814532176e-04
+#define DEGTRIG_PS5	 3.47933107596021167570e-05
+#define DEGTRIG_QS1	-2.40339491173441421878e+00
+#define DEGTRIG_QS2	 2.02094576023350569471e+00
+#define DEGTRIG_QS3	-6.88283971605453293030e-01
+#define DEGTRIG_QS4	 7.70381505559019352791e-02
+
+/* Polynomial approximation of atan (x) on [-7/16, 7/16].  */
+#define DEGTRIG_AT0	 3.33333333333329318027e-01
+#define DEGTRIG_AT1	-1.99999999998764832476e-01
+#define DEGTRIG_AT2	 1.42857142725034663711e-01
+#define DEGTRIG_AT3	-1.11111104054623557880e-01
+#define DEGTRIG_AT4	 9.09088713343650656196e-02
+#define DEGTRIG_AT5	-7.69187620504482999495e-02
+#define DEGTRIG_AT6	 6.66107313738753120669e-02
+#define DEGTRIG_AT7	-5.83357013379057348645e-02
+#define DEGTRIG_AT8	 4.97687799461593236017e-02
+#define DEGTRIG_AT9	-3.65315727442169155270e-02
+#define DEGTRIG_AT10	 1.62858201153657823623e-02
+
+/* tan (22.5 degrees).  */
+#define DEGTRIG_TAN_PI_8 0.41421356237309504880
+
+static inline double
+degtrig_sin_kernel (double t, double z)
+{
+  return t + t * z * (DEGTRIG_S1 + z * (DEGTRIG_S2 + z * (DEGTRIG_S3
+	    + z * (DEGTRIG_S4 + z * (DEGTRIG_S5 + z * DEGTRIG_S6)))));
+}
+
+static inline double
+degtrig_cos_kernel (double z)
+{
+  return 1.0 - 0.5 * z + z * z * (DEGTRIG_C1 + z * (DEGTRIG_C2
+	    + z * (DEGTRIG_C3 + z * (DEGTRIG_C4 + z * (DEGTRIG_C5
+	    + z * DEGTRIG_C6)))));
+}
+
+static inline double
+degtrig_asin_kernel (double x, double z)
+{
+  double p = z * (DEGTRIG_PS0 + z * (DEGTRIG_PS1 + z * (DEGTRIG_PS2
+	    + z * (DEGTRIG_PS3 + z * (DEGTRIG_PS4 + z * DEGTRIG_PS5)))));
+  double q = 1.0 + z * (DEGTRIG_QS1 + z * (DEGTRIG_QS2 + z * (DEGTRIG_QS3
+	    + z * DEGTRIG_QS4)));
+  return x + x * (p / q);
+}
+
+static inline double
+degtrig_atan_kernel (double x)
+{
+  double z = x * x, w = z * z;
+  double s1 = z * (DEGTRIG_AT0 + w * (DEGTRIG_AT2 + w * (DEGTRIG_AT4
+	    + w * (DEGTRIG_AT6 + w * (DEGTRIG_AT8 + w * DEGTRIG_AT10)))));
+  double s2 = w * (DEGTRIG_AT1 + w * (DEGTRIG_AT3 + w * (DEGTRIG_AT5
+	    + w * (DEGTRIG_AT7 + w * DEGTRIG_AT9))));
+  return x - x * (s1 + s2);
+}
+
+/* Compute the sine and cosine of X degrees.  */
+static inline void
+sincosd (double x, double *s, double *c)
+{
+  double q = rint (x * (1.0 / 90.0));
+  double r = x - q * 90.0;
+  double t = r * DEG_RAD, z = t * t;
+  double sr = degtrig_sin_kernel (t, z);
+  double cr = degtrig_cos_kernel (z);
+  long n = (long) q;
+
+  /* Negate with 0.0 - x, so that for example cosd (90.0) is +0.0
+     like cos (M_PI / 2) is positive.  */
+  if (n & 1)
+    {
+      double tmp = sr;
+      sr = cr, cr = 0.0 - tmp;
+    }
+  if (n & 2)
+    sr = 0.0 - sr, cr = 0.0 - cr;
+
+  *s = sr;
+  *c = cr;
+}
+
+static inline double
+sind (double x)
+{
+  double s, c;
+  sincosd (x, &s, &c);
+  return s;
+}
+
+static inline double
+cosd (double x)
+{
+  double s, c;
+  sincosd (x, &s, &c);
+  return c;
+}
+
+static inline double
+tand (double x)
+{
+  double s, c;
+  sincosd (x, &s, &c);
+  return s / c;
+}
+
+/* Compute the arc sine and arc cosine of X in degrees.  */
+static inline double
+asind (double x)
+{
+  double a = fabs (x), r;
+
+  if (a <= 0.5)
+    return RAD_DEG * degtrig_asin_kernel (x, x * x);
+
+  a = 0.5 * (1.0 - a);
+  r = 90.0 - 2.0 * RAD_DEG * degtrig_asin_kernel (sqrt (a), a);
+  return x < 0 ? -r : r;
+}
+
+static inline double
+acosd (double x)
+{
+  double a;
+
+  if (fabs (x) <= 0.5)
+    return 90.0 - RAD_DEG * degtrig_asin_kernel (x, x * x);
+
+  /* Near 1 or -1, use acos (x) = 2 asin (sqrt ((1 - x) / 2)) to avoid
+     cancellation.  */
+  a = 0.5 * (1.0 - fabs (x));
+  a = 2.0 * RAD_DEG * degtrig_asin_kernel (sqrt (a), a);
+  return x < 0 ? 180.0 - a : a;
+}
+
+/* Compute the arc tangent of Y/X in degrees, between -180 and 180.  */
+static inline double
+atan2d (double y, double x)
+{
+  double ax = fabs (x), ay = fabs (y), t, r;
+  int swap = ay > ax;
+
+  if (ax == 0.0 && ay == 0.0)
+    return signbit (x) ? (signbit (y) ? -180.0 : 180.0) : y;
+
+  /* Reduce to an angle between 0 and 45 degrees, and then to
+     [-22.5, 22.5] degrees around 0 or 45.  */
+  t = swap ? ax / ay : ay / ax;
+  if (t > DEGTRIG_TAN_PI_8)
+    r = 45.0 + RAD_DEG * degtrig_atan_kernel ((t - 1.0) / (t + 1.0));
+  else
+    r = RAD_DEG * degtrig_atan_kernel (t);
+
+  if (swap)
+    r = 90.0 - r;
+  if (x < 0)
+    r = 180.0 - r;
+  return signbit (y) ? -r : r;
+}
+
+static inline double
+atand (double x)
+{
+  return atan2d (x, 1.0);
+}
+
+/* Array versions of the above, using the processor's vector
+   instructions.  The arrays may overlap only if they are the same.  */
+extern void sincosd_array (const double *x, double *s, double *c, int n);
+extern void acosd_array (const double *x, double *r, int n);
+extern void atan2d_array (const double *y, const double *x, double *r, int n);
+
+#endif /* DEGTRIG_H */
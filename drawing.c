@@ -12,7 +12,7 @@
 #include "SDL.h"
 
 static cairo_t *
-create_cairo_context_1 (unsigned char *buffer)
+create_cairo_context_1 (unsigned char *buffer, int stride)
 {
   cairo_t *cairo_context;
   cairo_surface_t *surface;
@@ -21,7 +21,7 @@ create_cairo_context_1 (unsigned char *buffer)
   surface = cairo_image_surface_create_for_data (buffer,
 						 CAIRO_FORMAT_ARGB32,
 						 WIN_WIDTH, WIN_HEIGHT,
-						 4 * WIN_WIDTH);
+						 stride);
 
   if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
     {
@@ -44,7 +44,17 @@ create_cairo_context (void)
 {
   unsigned char *buffer;
   buffer = calloc (4 * WIN_WIDTH * WIN_HEIGHT, sizeof (char));
-  return create_cairo_context_1 (buffer);
+  return create_cairo_context_1 (buffer, 4 * WIN_WIDTH);
+}
+
+cairo_t *
+create_cairo_context_for_data (unsigned char *buffer, int stride)
+{
+  cairo_t *cairo_context = create_cairo_context_1 (buffer, stride);
+
+  /* The context keeps the surface alive.  */
+  cairo_surface_destroy (cairo_get_target (cairo_context));
+  return cairo_context;
 }
 
 void
@@ -70,7 +80,7 @@ init_sdl (void)
 {
   /* init cairo.  */
   unsigned char *buffer = calloc (4 * WIN_WIDTH * WIN_HEIGHT, sizeof (char));
-  cairo_t *cairo_context = create_cairo_context_1 (buffer);
+  cairo_t *cairo_context = create_cairo_context_1 (buffer, 4 * WIN_WIDTH);
 
   /* init SDL */
   if ((SDL_Init (SDL_INIT_VIDEO | SDL_INIT_TIMER) == -1))
@@ -18,6 +18,12 @@
 extern cairo_t *create_cairo_context (void);
 extern void destroy_cairo_context (cairo_t *);
 
+/* Create a context that draws on the ARGB32 pixels at BUFFER, whose
+   rows are STRIDE bytes apart.  BUFFER is not freed when the context
+   is destroyed with cairo_destroy.  */
+extern cairo_t *create_cairo_context_for_data (unsigned char *buffer,
+					       int stride);
+
 /* Functions used by main.c as a high-level interface with SDL.  */
 extern cairo_t *init_sdl (void);
 extern void free_sdl (void);
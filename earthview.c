@@ -6,47 +6,336 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
 
 #include "drawing.h"
 #include "anim.h"
 #include "map.h"
+#include "video.h"
+#include "sites.h"
+#include "heatmap.h"
+#include "record.h"
+#include "framering.h"
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+	   "Usage: earthview [-y | -r] [-d] [-f FPS] [-n FRAMES] [-t START]\n"
+	   "                 [-l SITES] [-R LOG | -P LOG [-H]] [-T TRACE] [-S NAME]\n"
+	   "\n"
+	   "  -y         write frames to stdout in YUV4MPEG2 format\n"
+	   "  -r         write frames to stdout as raw 24-bit RGB\n"
+	   "  -d         advance by one day per frame instead of one minute\n"
+	   "  -f FPS     frame rate stored in the YUV4MPEG2 header (default 25)\n"
+	   "  -n FRAMES  number of frames to write (default 1440)\n"
+	   "  -t START   time of the first frame, as YYYY-MM-DD or\n"
+	   "             YYYY-MM-DDTHH:MM in UTC (default now)\n"
+	   "  -l SITES   show the sites listed in the file SITES, one per line\n"
+	   "             as longitude, latitude and an optional name\n"
+	   "  -R LOG     record the starting time, the keys and the clock to LOG\n"
+	   "  -P LOG     replay the input recorded in LOG, as fast as possible\n"
+	   "  -H         with -P, do not open a window\n"
+	   "  -T TRACE   write the time spent on each frame to TRACE\n"
+	   "  -S NAME    publish the frames in the shared memory object NAME,\n"
+	   "             for example /earthview (see framering.h)\n"
+	   "\n"
+	   "Without -y or -r, the map is shown in a window.\n"
+	   "The video can be encoded with, for example,\n"
+	   "  earthview -y | ffmpeg -i - earth.mp4\n"
+	   "  earthview -r | ffmpeg -f rawvideo -pix_fmt rgb24 -s %dx%d -i - earth.mp4\n",
+	   WIN_WIDTH, WIN_HEIGHT);
+  exit (1);
+}
+
+static double
+get_time (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/* With -S, the frames are drawn directly in the slots of the frame
+   ring, through these contexts.  */
+#define SHM_SLOTS 3
+
+static cairo_t *slot_contexts[SHM_SLOTS];
+static int publishing;
+
+static void
+open_frame_ring (const char *name)
+{
+  int i;
+
+  if (frame_ring_open (name, WIN_WIDTH, WIN_HEIGHT, SHM_SLOTS) < 0)
+    {
+      perror (name);
+      exit (1);
+    }
+
+  for (i = 0; i < SHM_SLOTS; i++)
+    slot_contexts[i] = create_cairo_context_for_data
+      ((unsigned char *) frame_ring_slot (i), 4 * WIN_WIDTH);
+  publishing = 1;
+}
+
+static void
+close_frame_ring (void)
+{
+  int i;
+
+  if (!publishing)
+    return;
+
+  for (i = 0; i < SHM_SLOTS; i++)
+    cairo_destroy (slot_contexts[i]);
+  frame_ring_close ();
+  publishing = 0;
+}
+
+/* Return the context on which to draw the next frame: the next slot of
+   the frame ring if publishing, otherwise CAIRO_CONTEXT.  */
+static cairo_t *
+begin_frame (cairo_t *cairo_context)
+{
+  return publishing ? slot_contexts[frame_ring_begin ()] : cairo_context;
+}
+
+/* Finish the frame drawn on CONTEXT, which begin_frame returned.  If
+   it is a slot of the frame ring, publish it and, if COPY is true, copy
+   it to CAIRO_CONTEXT too.  */
+static void
+end_frame (cairo_t *cairo_context, cairo_t *context, int copy)
+{
+  cairo_surface_flush (cairo_get_target (context));
+  if (context == cairo_context)
+    return;
+
+  frame_ring_publish ();
+  if (copy)
+    {
+      cairo_save (cairo_context);
+      cairo_set_operator (cairo_context, CAIRO_OPERATOR_SOURCE);
+      cairo_set_source_surface (cairo_context, cairo_get_target (context),
+				0, 0);
+      cairo_paint (cairo_context);
+      cairo_restore (cairo_context);
+    }
+}
+
+/* Render FRAMES frames without opening a window, starting at the
+   current time, and write them to stdout.  */
+static int
+write_video (enum video_format format, int fps, int frames)
+{
+  cairo_t *cairo_context = create_cairo_context ();
+  double start;
+  int i, rc = 0;
+
+  /* Stop with an error instead of dying if the reader goes away.  */
+  signal (SIGPIPE, SIG_IGN);
+  if (video_open (1, format, WIN_WIDTH, WIN_HEIGHT, fps) < 0)
+    {
+      perror ("earthview");
+      return 1;
+    }
+
+  start = get_time ();
+  for (i = 0; i < frames; i++)
+    {
+      cairo_t *context = begin_frame (cairo_context);
+      cairo_surface_t *surface = cairo_get_target (context);
+      SDL_Event event;
+
+      event.type = -1;
+      do_map (context, &event);
+      do_heatmap (context, &event);
+      do_sites (context, &event);
+
+      cairo_surface_flush (surface);
+      if (video_write_frame ((const uint32_t *)
+			     cairo_image_surface_get_data (surface),
+			     cairo_image_surface_get_stride (surface)) < 0)
+	{
+	  perror ("earthview");
+	  rc = 1;
+	}
+
+      end_frame (cairo_context, context, 0);
+      if (rc)
+	break;
+
+      anim_step (&cur_time, anim_speed ());
+    }
+
+  /* After a failed frame, video_close fails with the same error.  */
+  if (video_close () < 0 && !rc)
+    {
+      perror ("earthview");
+      rc = 1;
+    }
+
+  fprintf (stderr, "%d frames, %.2f fps\n", i, i / (get_time () - start));
+
+  destroy_cairo_context (cairo_context);
+  return rc;
+}
 
 int
 main (int argc, char **argv)
 {
-  unsigned int i = 0, start_ticks;
-
-  /* initialize SDL and create as OpenGL-texture source */
-  cairo_t *cairo_context = init_sdl ();
+  unsigned int i = 0;
+  int video = 0, fps = 25, frames = 1440, headless = 0;
+  enum video_format format = VIDEO_Y4M;
+  const char *record_file = NULL, *replay_file = NULL, *shm_name = NULL;
+  FILE *trace = NULL;
+  struct time start;
+  cairo_t *cairo_context;
+  double start_time;
+  int c, n, rc;
 
   init_anim ();
+  start = cur_time;
+
+  while ((c = getopt (argc, argv, "yrdf:n:t:l:R:P:HT:S:")) != -1)
+    switch (c)
+      {
+      case 'y':
+	video = 1, format = VIDEO_Y4M;
+	break;
+      case 'r':
+	video = 1, format = VIDEO_RGB;
+	break;
+      case 'd':
+	anim_set_speed (2);
+	break;
+      case 'f':
+	fps = atoi (optarg);
+	if (fps <= 0)
+	  usage ();
+	break;
+      case 'n':
+	frames = atoi (optarg);
+	if (frames <= 0)
+	  usage ();
+	break;
+      case 't':
+	start.h = start.m = 0;
+	n = sscanf (optarg, "%d-%d-%dT%d:%d", &start.year, &start.month,
+		    &start.day, &start.h, &start.m);
+	if (n != 3 && n != 5)
+	  usage ();
+	break;
+      case 'l':
+	if (init_sites (optarg) < 0)
+	  {
+	    perror (optarg);
+	    exit (1);
+	  }
+	break;
+      case 'R':
+	record_file = optarg;
+	break;
+      case 'P':
+	replay_file = optarg;
+	break;
+      case 'H':
+	headless = 1;
+	break;
+      case 'S':
+	shm_name = optarg;
+	break;
+      case 'T':
+	trace = fopen (optarg, "w");
+	if (!trace)
+	  {
+	    perror (optarg);
+	    exit (1);
+	  }
+	break;
+      default:
+	usage ();
+      }
+
+  if (optind < argc || (record_file && replay_file)
+      || (headless && !replay_file))
+    usage ();
+
   init_map ();
+  if (shm_name)
+    open_frame_ring (shm_name);
 
-  start_ticks = SDL_GetTicks ();
+  if (video)
+    {
+      cur_time = start;
+      rc = write_video (format, fps, frames);
+      close_frame_ring ();
+      return rc;
+    }
+
+  /* initialize SDL and create as OpenGL-texture source */
+  if (headless)
+    cairo_context = create_cairo_context ();
+  else
+    cairo_context = init_sdl ();
+
+  cur_time = start;
+  if (record_file && record_open (record_file) < 0)
+    {
+      perror (record_file);
+      exit (1);
+    }
+  if (replay_file && replay_open (replay_file) < 0)
+    {
+      fprintf (stderr, "earthview: cannot read log %s\n", replay_file);
+      exit (1);
+    }
+  start_time = get_time ();
 
   /* enter event-loop */
   for (;;)
     {
       SDL_Event event;
+      cairo_t *context;
+      double frame_time;
+
       i++;
-      draw_sdl ();
+      if (!headless)
+	draw_sdl ();
       event.type = -1;
-      SDL_PollEvent (&event);
+      if (!replaying ())
+	SDL_PollEvent (&event);
+      record_event (&event);
 
       /* check for user hitting close-window widget */
       if (event.type == SDL_QUIT)
 	break;
 
       /* Call functions here to parse event and render on cairo_context...  */
-      do_anim (cairo_context, &event);
-      do_map (cairo_context, &event);
+      frame_time = get_time ();
+      context = begin_frame (cairo_context);
+      do_anim (context, &event);
+      do_map (context, &event);
+      do_heatmap (context, &event);
+      do_sites (context, &event);
+      end_frame (cairo_context, context, !headless);
+      if (trace)
+	fprintf (trace, "%u %.0f\n", i, (get_time () - frame_time) * 1e6);
     }
 
-  printf ("%.2f fps\n", (i * 1000.0) / (SDL_GetTicks () - start_ticks));
+  printf ("%.2f fps\n", i / (get_time () - start_time));
 
   /* clear resources before exit */
+  record_close ();
+  close_frame_ring ();
+  if (trace)
+    fclose (trace);
   destroy_cairo_context (cairo_context);
-  free_sdl ();
+  if (!headless)
+    free_sdl ();
 
   return 0;
 }
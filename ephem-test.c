@@ -0,0 +1,133 @@
+/* Tabulated solar ephemeris - validation program.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "sunrise.h"
+#include "ephem.h"
+
+/* Samples per day.  */
+#define STEPS 16
+
+#define N_LATS 5
+static const double lats[N_LATS] = { -60.0, -30.0, 0.0, 30.0, 60.0 };
+
+static double
+elapsed (struct timespec *start)
+{
+  struct timespec end;
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+int
+main (int argc, char **argv)
+{
+  int first_year = 2000, last_year = 2030;
+  double max_dec = 0, max_ra = 0, max_eqt = 0, max_r = 0, max_rise = 0;
+  double d, first_day, last_day, sum = 0;
+  struct timespec start;
+  double t_exact, t_table;
+  struct { double rise, set; int rc; } *rise_set;
+  int i, n_rise;
+  long n;
+
+  if (argc == 3)
+    first_year = atoi (argv[1]), last_year = atoi (argv[2]);
+  else if (argc != 1)
+    {
+      fprintf (stderr, "Usage: ephem-test [FIRST-YEAR LAST-YEAR]\n");
+      exit (1);
+    }
+
+  n_rise = (int) ((last_year - first_year + 1) * 365.25 / 7) * N_LATS;
+  rise_set = malloc (n_rise * sizeof (*rise_set));
+  for (i = 0; i < n_rise; i++)
+    rise_set[i].rc = sun_rise_set (first_year, 1, 1 + (i / N_LATS) * 7, 8.95,
+				   lats[i % N_LATS],
+				   &rise_set[i].rise, &rise_set[i].set);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  if (ephem_init (first_year, last_year) != 0)
+    {
+      fprintf (stderr, "ephem-test: cannot build tables\n");
+      exit (1);
+    }
+  printf ("==> Tables for %d-%d built in %.2f ms\n", first_year, last_year,
+	  elapsed (&start) * 1000.0);
+
+  first_day = floor ((first_year - 2000) * 365.25);
+  last_day = floor ((last_year + 1 - 2000) * 365.25);
+  for (n = 0, d = first_day; d < last_day; d += 1.0 / STEPS, n++)
+    {
+      struct sun_ephemeris exact, tab;
+      double dra;
+
+      calc_sun_ephemeris_exact (d, &exact);
+      if (!ephem_lookup (d, &tab))
+	{
+	  printf ("==> Day %.2f not covered by the tables!\n", d);
+	  exit (1);
+	}
+
+      dra = fabs (tab.ra - exact.ra);
+      if (dra > 180.0)
+	dra = 360.0 - dra;
+
+      max_dec = fmax (max_dec, fabs (asin (tab.sdec) - asin (exact.sdec)));
+      max_dec = fmax (max_dec, fabs (acos (tab.cdec) - acos (exact.cdec)));
+      max_ra = fmax (max_ra, dra);
+      max_eqt = fmax (max_eqt, fabs (tab.eqtime - exact.eqtime));
+      max_r = fmax (max_r, fabs (tab.r - exact.r));
+    }
+
+  /* Sunrise and sunset times, at one longitude and a few latitudes, once
+     a week.  The exact times were computed before building the tables.  */
+  for (i = 0; i < n_rise; i++)
+    {
+      double rise, set;
+      int rc = sun_rise_set (first_year, 1, 1 + (i / N_LATS) * 7, 8.95,
+			     lats[i % N_LATS], &rise, &set);
+      if (rc != rise_set[i].rc)
+	max_rise = INFINITY;
+      else
+	max_rise = fmax (max_rise, fmax (fabs (rise - rise_set[i].rise),
+					 fabs (set - rise_set[i].set)));
+    }
+
+  printf ("==> %ld samples compared\n", n);
+  printf ("==> Max declination error:     %.3g arcsec\n",
+	  max_dec * 180.0 / M_PI * 3600.0);
+  printf ("==> Max right ascension error: %.3g arcsec\n", max_ra * 3600.0);
+  printf ("==> Max equation of time error: %.3g s\n", max_eqt * 240.0);
+  printf ("==> Max solar distance error:  %.3g AU\n", max_r);
+  printf ("==> Max sunrise/sunset error:  %.3g s\n", max_rise * 3600.0);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (d = first_day; d < last_day; d += 1.0 / STEPS)
+    {
+      struct sun_ephemeris se;
+      calc_sun_ephemeris_exact (d, &se);
+      sum += se.ra;
+    }
+  t_exact = elapsed (&start);
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (d = first_day; d < last_day; d += 1.0 / STEPS)
+    {
+      struct sun_ephemeris se;
+      ephem_lookup (d, &se);
+      sum -= se.ra;
+    }
+  t_table = elapsed (&start);
+
+  printf ("==> Formulas: %.1f ns/call, tables: %.1f ns/call (%g)\n",
+	  t_exact * 1e9 / n, t_table * 1e9 / n, sum);
+  return 0;
+}
@@ -0,0 +1,121 @@
+/* Tabulated solar ephemeris.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "ephem.h"
+
+/* The declination, equation of time and solar distance change slowly
+   over the year.  For each segment of SEGMENT_DAYS days, they are
+   approximated by a sum of Chebyshev polynomials, whose coefficients are
+   obtained by sampling the formulas in sunrise.c at the Chebyshev nodes.
+   The right ascension is then the mean longitude minus the equation
+   of time.  */
+
+#define SEGMENT_DAYS	32
+#define N_COEFFS	10
+
+enum quantity
+{
+  SDEC, CDEC, EQTIME, R, N_QUANTITIES
+};
+
+static double first_day;
+static int n_segments;
+static double (*table)[N_COEFFS][N_QUANTITIES];
+
+int
+ephem_init (int first_year, int last_year)
+{
+  double last_day, f[N_COEFFS][N_QUANTITIES];
+  int i, j, k, q;
+
+  ephem_free ();
+
+  /* Leave some slack for the longitude correction.  */
+  first_day = floor ((first_year - 2000) * 365.25) - 2.0;
+  last_day = ceil ((last_year + 1 - 2000) * 365.25) + 2.0;
+  n_segments = ceil ((last_day - first_day) / SEGMENT_DAYS);
+  if (n_segments <= 0)
+    return -1;
+
+  table = malloc (n_segments * sizeof (*table));
+  if (!table)
+    return -1;
+
+  for (i = 0; i < n_segments; i++)
+    {
+      double mid = first_day + (i + 0.5) * SEGMENT_DAYS;
+
+      for (k = 0; k < N_COEFFS; k++)
+	{
+	  struct sun_ephemeris se;
+	  double x = cos (M_PI * (k + 0.5) / N_COEFFS);
+
+	  calc_sun_ephemeris_exact (mid + x * SEGMENT_DAYS / 2, &se);
+	  f[k][SDEC] = se.sdec;
+	  f[k][CDEC] = se.cdec;
+	  f[k][EQTIME] = se.eqtime;
+	  f[k][R] = se.r;
+	}
+
+      for (j = 0; j < N_COEFFS; j++)
+	for (q = 0; q < N_QUANTITIES; q++)
+	  {
+	    double sum = 0.0;
+	    for (k = 0; k < N_COEFFS; k++)
+	      sum += f[k][q] * cos (M_PI * j * (k + 0.5) / N_COEFFS);
+	    table[i][j][q] = (j == 0 ? 1.0 : 2.0) * sum / N_COEFFS;
+	  }
+    }
+
+  return 0;
+}
+
+void
+ephem_free (void)
+{
+  free (table);
+  table = NULL;
+  n_segments = 0;
+}
+
+int
+ephem_lookup (double d, struct sun_ephemeris *se)
+{
+  double t, x, ra;
+  double b1[N_QUANTITIES] = { 0 }, b2[N_QUANTITIES] = { 0 };
+  const double (*c)[N_QUANTITIES];
+  int i, j, q;
+
+  t = (d - first_day) / SEGMENT_DAYS;
+  if (!(t >= 0.0 && t < n_segments))
+    return 0;
+
+  i = (int) t;
+  x = 2.0 * (t - i) - 1.0;
+  c = (const double (*)[N_QUANTITIES]) table[i];
+
+  /* Clenshaw's recurrence, for all quantities at once.  */
+  for (j = N_COEFFS - 1; j >= 1; j--)
+    for (q = 0; q < N_QUANTITIES; q++)
+      {
+	double b0 = 2.0 * x * b1[q] - b2[q] + c[j][q];
+	b2[q] = b1[q];
+	b1[q] = b0;
+      }
+
+  se->sdec = x * b1[SDEC] - b2[SDEC] + c[0][SDEC];
+  se->cdec = x * b1[CDEC] - b2[CDEC] + c[0][CDEC];
+  se->eqtime = x * b1[EQTIME] - b2[EQTIME] + c[0][EQTIME];
+  se->r = x * b1[R] - b2[R] + c[0][R];
+
+  ra = sun_mean_longitude (d) - se->eqtime;
+  se->ra = ra - 360.0 * floor (ra / 360.0 + 0.5);
+  return 1;
+}
@@ -0,0 +1,26 @@
+/* Tabulated solar ephemeris.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef EPHEM_H
+#define EPHEM_H
+
+#include "sunrise.h"
+
+/* Fit Chebyshev polynomials to the Sun's position between the start
+   of FIRST_YEAR and the end of LAST_YEAR; after this call, the sunrise
+   and sunset functions will use them for dates in that range.  Return
+   0 on success, -1 if out of memory.  This function is not thread-safe,
+   and it should be called before the tables are used.  */
+extern int ephem_init (int first_year, int last_year);
+
+/* Go back to computing the Sun's position from the formulas.  */
+extern void ephem_free (void);
+
+/* If the tables cover D, the number of days since 2000 Jan 0.0,
+   store the Sun's position in *SE and return 1; else return 0.  */
+extern int ephem_lookup (double d, struct sun_ephemeris *se);
+
+#endif /* EPHEM_H */
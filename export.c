@@ -0,0 +1,433 @@
+/* Terminator export.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "sunrise.h"
+#include "contour.h"
+#include "terminator.h"
+#include "parallel.h"
+#include "export.h"
+
+/* The boundaries are traced with terminator.c on a grid of WIDTH x
+   HEIGHT points, where point X, Y is at longitude -180 + X * DLON and
+   latitude 90 - Y * DLAT.  Each point of a contour is the top left
+   corner of a cell that the boundary crosses, and stands for the center
+   of the cell.
+
+   Instants are split in chunks of CHUNK_INSTANTS, and as many chunks
+   as there are threads are traced (and formatted) in parallel, and then
+   written in order.  Each thread keeps its own tracers, so that each
+   trace in a chunk starts from the previous one.
+
+   The GeoJSON output is a FeatureCollection with one Polygon feature
+   for each instant and level, whose properties are "time" and "level".
+   Its first ring goes counterclockwise around the lit region, and the
+   second, if present, clockwise around a dark hole in it.  Coordinates
+   are clamped to the valid range, and points in the middle of straight
+   runs are omitted.
+
+   The binary format starts with the 8 bytes "TERMLINE", two 32-bit
+   integers WIDTH and HEIGHT, and four doubles: the longitude and
+   latitude of point 0, 0 (that is, -180 and 90), DLON and DLAT.  Each
+   instant and level then has a record made of a 64-bit integer (the time
+   in seconds since 1970), two 32-bit integers (the level and the number
+   of rings), and the rings.  A ring has a 32-bit integer with the number
+   of points N, two 16-bit integers with X and Y for the first point, and
+   N - 1 moves to the following points, packed four per byte starting
+   from the least significant bits: 0 decreases Y, 1 decreases X, 2
+   increases Y, 3 increases X.  The ring goes back to the first point
+   after the last.  Points can be a few cells outside the grid, and the
+   coordinates of their cells should be clamped.  Numbers are in the
+   machine's byte order.  */
+
+#define CHUNK_INSTANTS	60
+
+enum move
+{
+  MOVE_UP, MOVE_LT, MOVE_DN, MOVE_RT
+};
+
+static const char *const level_names[N_LEVELS] = {
+  "sunrise", "civil", "nautical", "astronomical"
+};
+
+static sun_rise_set_fn *const level_fn[N_LEVELS] = {
+  sun_rise_set, civil_rise_set, nautical_rise_set, astro_rise_set
+};
+
+struct chunk
+{
+  const struct export_options *opts;
+  double dlon, dlat;
+
+  struct terminator *tr[N_LEVELS];
+  struct contour contour;
+  long *coords;
+  int max_coords;
+
+  long first, n;
+  char *buf;
+  size_t len, size;
+};
+
+const char *
+level_name (enum terminator_level level)
+{
+  return level_names[level];
+}
+
+/* Make room for N more bytes in C's buffer.  */
+static char *
+reserve (struct chunk *c, size_t n)
+{
+  if (c->len + n > c->size)
+    {
+      while (c->len + n > c->size)
+	c->size = c->size ? c->size * 2 : 65536;
+      c->buf = realloc (c->buf, c->size);
+      if (!c->buf)
+	abort ();
+    }
+
+  return c->buf + c->len;
+}
+
+static void
+put_bytes (struct chunk *c, const void *p, size_t n)
+{
+  memcpy (reserve (c, n), p, n);
+  c->len += n;
+}
+
+/* Write N thousandths at P, without trailing zeros in the fraction,
+   and return the end of the string.  */
+static char *
+put_milli (char *p, long n)
+{
+  char buf[24], *q = buf + sizeof (buf);
+  int i, frac;
+
+  if (n < 0)
+    *p++ = '-', n = -n;
+
+  frac = n % 1000;
+  n /= 1000;
+  if (frac)
+    {
+      for (i = 0; i < 3; i++, frac /= 10)
+	if (frac % 10 || q != buf + sizeof (buf))
+	  *--q = '0' + frac % 10;
+      *--q = '.';
+    }
+  do
+    *--q = '0' + n % 10;
+  while (n /= 10);
+
+  i = buf + sizeof (buf) - q;
+  memcpy (p, q, i);
+  return p + i;
+}
+
+static long
+clamp_milli (double x, double limit)
+{
+  if (x < -limit)
+    x = -limit;
+  if (x > limit)
+    x = limit;
+  return lrint (x * 1000.0);
+}
+
+/* Convert the points of ring R of C->CONTOUR to thousandths of a degree
+   in C->COORDS, dropping repeated points and points that are in the
+   middle of a straight run.  Return the number of points left.  */
+static int
+ring_coords (struct chunk *c, int r)
+{
+  const struct contour *ct = &c->contour;
+  int start = ct->rings[r];
+  int end = (r + 1 < ct->n_rings ? ct->rings[r + 1] : ct->n_pts);
+  long *p;
+  int i, n = 0;
+
+  if (c->max_coords < 2 * (end - start))
+    {
+      c->max_coords = 2 * (end - start);
+      c->coords = realloc (c->coords, c->max_coords * sizeof (long));
+      if (!c->coords)
+	abort ();
+    }
+
+  p = c->coords;
+  for (i = start; i < end; i++)
+    {
+      long lon = clamp_milli (-180.0 + (ct->pts[i].x + 0.5) * c->dlon, 180.0);
+      long lat = clamp_milli (90.0 - (ct->pts[i].y + 0.5) * c->dlat, 90.0);
+
+      if (n > 0 && p[2 * n - 2] == lon && p[2 * n - 1] == lat)
+	continue;
+
+      /* Drop the previous point if it is between its predecessor
+	 and this one.  */
+      if (n > 1)
+	{
+	  long ax = p[2 * n - 2] - p[2 * n - 4], ay = p[2 * n - 1] - p[2 * n - 3];
+	  long bx = lon - p[2 * n - 2], by = lat - p[2 * n - 1];
+	  if (ax * by == ay * bx && ax * bx + ay * by > 0)
+	    n--;
+	}
+
+      p[2 * n] = lon;
+      p[2 * n + 1] = lat;
+      n++;
+    }
+
+  while (n > 1 && p[2 * n - 2] == p[0] && p[2 * n - 1] == p[1])
+    n--;
+
+  return n;
+}
+
+/* Write the N points in C->COORDS as a closed GeoJSON linear ring,
+   going counterclockwise if CCW is true, else clockwise.  */
+static void
+put_ring (struct chunk *c, int n, int ccw)
+{
+  const long *p = c->coords;
+  double area = 0.0;
+  char *q;
+  int i, j, dir;
+
+  for (i = 0, j = n - 1; i < n; j = i++)
+    area += (double) p[2 * j] * p[2 * i + 1] - (double) p[2 * i] * p[2 * j + 1];
+
+  if ((area > 0) == ccw)
+    i = 0, dir = 1;
+  else
+    i = n - 1, dir = -1;
+
+  /* "[", the points, the first one again and "]".  */
+  q = reserve (c, (n + 1) * 24 + 2);
+  *q++ = '[';
+  for (j = 0; j <= n; j++, i += dir)
+    {
+      const long *pt = p + 2 * ((i + n) % n);
+      *q++ = '[';
+      q = put_milli (q, pt[0]);
+      *q++ = ',';
+      q = put_milli (q, pt[1]);
+      *q++ = ']';
+      if (j < n)
+	*q++ = ',';
+    }
+  *q++ = ']';
+  c->len = q - c->buf;
+}
+
+/* Write C->CONTOUR as a GeoJSON feature, preceded by a comma unless it
+   is the first one.  */
+static void
+put_geojson (struct chunk *c, int first, const char *when,
+	     enum terminator_level level)
+{
+  char head[160];
+  int r, n_rings = 0;
+
+  snprintf (head, sizeof (head),
+	    "%s{\"type\":\"Feature\",\"properties\":"
+	    "{\"time\":\"%s\",\"level\":\"%s\"},"
+	    "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[",
+	    first ? "" : ",\n", when, level_names[level]);
+  put_bytes (c, head, strlen (head));
+
+  /* Rings that are reduced to less than three points by clamping are
+     left out.  */
+  for (r = 0; r < c->contour.n_rings; r++)
+    {
+      int n = ring_coords (c, r);
+      if (n < 3)
+	continue;
+      if (n_rings++)
+	put_bytes (c, ",", 1);
+      put_ring (c, n, r == 0);
+    }
+
+  put_bytes (c, "]}}", 3);
+}
+
+static void
+put_binary (struct chunk *c, time_t t, enum terminator_level level)
+{
+  const struct contour *ct = &c->contour;
+  int64_t when = t;
+  int32_t hdr[2] = { level, ct->n_rings };
+  int r;
+
+  put_bytes (c, &when, sizeof (when));
+  put_bytes (c, hdr, sizeof (hdr));
+  for (r = 0; r < ct->n_rings; r++)
+    {
+      int start = ct->rings[r];
+      int end = (r + 1 < ct->n_rings ? ct->rings[r + 1] : ct->n_pts);
+      int32_t n = end - start;
+      int16_t xy[2] = { ct->pts[start].x, ct->pts[start].y };
+      unsigned char *q;
+      int i;
+
+      put_bytes (c, &n, sizeof (n));
+      put_bytes (c, xy, sizeof (xy));
+
+      q = (unsigned char *) reserve (c, (n + 2) / 4);
+      memset (q, 0, (n + 2) / 4);
+      for (i = 1; i < n; i++)
+	{
+	  const struct contour_point *a = &ct->pts[start + i - 1];
+	  const struct contour_point *b = &ct->pts[start + i];
+	  enum move m = (b->y < a->y ? MOVE_UP : b->x < a->x ? MOVE_LT
+			 : b->y > a->y ? MOVE_DN : MOVE_RT);
+	  q[(i - 1) / 4] |= m << (2 * ((i - 1) % 4));
+	}
+      c->len += (n + 2) / 4;
+    }
+}
+
+static void
+export_chunk (int i, void *data)
+{
+  struct chunk *c = (struct chunk *) data + i;
+  const struct export_options *opts = c->opts;
+  long k;
+
+  c->len = 0;
+  for (k = c->first; k < c->first + c->n; k++)
+    {
+      time_t t = opts->start + k * opts->step;
+      char when[32];
+      struct tm tm;
+      double hours;
+      int level, n_levels = 0;
+
+      gmtime_r (&t, &tm);
+      strftime (when, sizeof (when), "%Y-%m-%dT%H:%M:%SZ", &tm);
+      hours = tm.tm_hour + tm.tm_min / 60.0 + tm.tm_sec / 3600.0;
+
+      for (level = 0; level < N_LEVELS; level++)
+	{
+	  if (!(opts->levels & (1 << level)))
+	    continue;
+
+	  trace_terminator (c->tr[level], tm.tm_year + 1900, tm.tm_mon + 1,
+			    tm.tm_mday, hours, &c->contour);
+
+	  if (opts->format == EXPORT_BINARY)
+	    put_binary (c, t, level);
+	  else
+	    put_geojson (c, k == 0 && n_levels == 0, when, level);
+	  n_levels++;
+	}
+    }
+}
+
+int
+export_terminators (FILE *out, const struct export_options *opts)
+{
+  struct chunk *chunks;
+  double *lon, *lat;
+  int width, height, n_chunks, i, level;
+  long next;
+  int rc = 0;
+
+  if (opts->resolution <= 0.0 || opts->resolution > 45.0
+      || opts->count < 0 || opts->step < 0
+      || (opts->levels & ((1 << N_LEVELS) - 1)) == 0)
+    return -1;
+
+  /* Keep the points inside the range of a short.  */
+  height = (int) rint (180.0 / opts->resolution) + 1;
+  width = 2 * (height - 1);
+  if (width > 30000)
+    return -1;
+
+  lon = malloc (width * sizeof (double));
+  lat = malloc (height * sizeof (double));
+  n_chunks = parallel_threads ();
+  chunks = calloc (n_chunks, sizeof (struct chunk));
+  if (!lon || !lat || !chunks)
+    abort ();
+
+  for (i = 0; i < width; i++)
+    lon[i] = -180.0 + i * 360.0 / width;
+  for (i = 0; i < height; i++)
+    lat[i] = 90.0 - i * 180.0 / (height - 1);
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      struct chunk *c = &chunks[i];
+      c->opts = opts;
+      c->dlon = 360.0 / width;
+      c->dlat = 180.0 / (height - 1);
+      for (level = 0; level < N_LEVELS; level++)
+	if (opts->levels & (1 << level))
+	  c->tr[level] = new_terminator (level_fn[level], width, height,
+					 lon, lat);
+    }
+
+  if (opts->format == EXPORT_BINARY)
+    {
+      int32_t size[2] = { width, height };
+      double grid[4] = { -180.0, 90.0, chunks[0].dlon, chunks[0].dlat };
+      fwrite ("TERMLINE", 8, 1, out);
+      fwrite (size, sizeof (size), 1, out);
+      fwrite (grid, sizeof (grid), 1, out);
+    }
+  else
+    fputs ("{\"type\":\"FeatureCollection\",\"features\":[\n", out);
+
+  for (next = 0; next < opts->count && !ferror (out); )
+    {
+      int n = 0;
+
+      while (n < n_chunks && next < opts->count)
+	{
+	  struct chunk *c = &chunks[n++];
+	  c->first = next;
+	  c->n = opts->count - next < CHUNK_INSTANTS ? opts->count - next
+	    : CHUNK_INSTANTS;
+	  next += c->n;
+	}
+
+      parallel_for (n, export_chunk, chunks);
+      for (i = 0; i < n; i++)
+	fwrite (chunks[i].buf, 1, chunks[i].len, out);
+    }
+
+  if (opts->format == EXPORT_GEOJSON)
+    fputs ("\n]}\n", out);
+
+  if (fflush (out) != 0 || ferror (out))
+    rc = -1;
+
+  for (i = 0; i < n_chunks; i++)
+    {
+      for (level = 0; level < N_LEVELS; level++)
+	if (chunks[i].tr[level])
+	  free_terminator (chunks[i].tr[level]);
+      contour_free (&chunks[i].contour);
+      free (chunks[i].coords);
+      free (chunks[i].buf);
+    }
+
+  free (chunks);
+  free (lon);
+  free (lat);
+  return rc;
+}
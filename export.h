@@ -0,0 +1,51 @@
+/* Terminator export interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include <time.h>
+
+enum terminator_level
+{
+  LEVEL_SUNRISE, LEVEL_CIVIL, LEVEL_NAUTICAL, LEVEL_ASTRONOMICAL, N_LEVELS
+};
+
+enum export_format
+{
+  EXPORT_GEOJSON, EXPORT_BINARY
+};
+
+struct export_options
+{
+  enum export_format format;
+
+  /* The levels to export, as a mask of 1 << LEVEL_*.  */
+  unsigned levels;
+
+  /* Degrees between the points where the Sun's altitude is checked.
+     This is rounded so that it divides 180 degrees.  */
+  double resolution;
+
+  /* The first instant, the number of instants, and the seconds between
+     two instants.  */
+  time_t start;
+  long count;
+  long step;
+};
+
+/* Return the name of LEVEL, as used in the GeoJSON output.  */
+extern const char *level_name (enum terminator_level level);
+
+/* Write to OUT the regions where the Sun is up, for each of the levels
+   and instants in OPTS; see export.c for the formats.  Nothing is kept
+   in memory after it is written, so the series can be arbitrarily long.
+   Return 0 on success, -1 if the options are invalid or writing
+   failed.  */
+extern int export_terminators (FILE *out, const struct export_options *opts);
+
+#endif /* EXPORT_H */
@@ -0,0 +1,130 @@
+/* Shared memory frame ring.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "framering.h"
+
+/* The frames are drawn directly in their slot, so publishing one does
+   not need to copy it or to compare it with the previous one.  */
+
+static struct frame_ring *ring;
+static char *ring_name;
+
+int
+frame_ring_open (const char *name, int width, int height, int n_slots)
+{
+  long page = sysconf (_SC_PAGESIZE);
+  size_t header, frame, size;
+  void *p;
+  int fd, i;
+
+  if (n_slots < 1 || n_slots > FRAME_RING_MAX_SLOTS)
+    return -1;
+
+  header = (sizeof (struct frame_ring) + page - 1) / page * page;
+  frame = (size_t) width * height * 4;
+  size = header + n_slots * frame;
+
+  /* Do not shrink an object that readers may still have mapped, which
+     would kill them with SIGBUS; replace it with a new one.  */
+  shm_unlink (name);
+  fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+    return -1;
+
+  if (ftruncate (fd, size) < 0)
+    {
+      close (fd);
+      shm_unlink (name);
+      return -1;
+    }
+
+  p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);
+  if (p == MAP_FAILED)
+    {
+      shm_unlink (name);
+      return -1;
+    }
+
+  ring = p;
+  ring_name = strdup (name);
+  if (!ring_name)
+    abort ();
+
+  ring->width = width;
+  ring->height = height;
+  ring->stride = width * 4;
+  ring->n_slots = n_slots;
+  ring->size = size;
+  for (i = 0; i < n_slots; i++)
+    ring->slots[i].offset = header + i * frame;
+
+  /* Readers check the magic string last.  */
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  memcpy (ring->magic, FRAME_RING_MAGIC, 8);
+  return 0;
+}
+
+uint32_t *
+frame_ring_slot (int i)
+{
+  return (uint32_t *) ((char *) ring + ring->slots[i].offset);
+}
+
+int
+frame_ring_begin (void)
+{
+  uint64_t seq = ring->seq + 1;
+  struct frame_slot *slot = &ring->slots[seq % ring->n_slots];
+
+  __atomic_store_n (&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  return seq % ring->n_slots;
+}
+
+void
+frame_ring_publish (void)
+{
+  uint64_t seq = ring->seq + 1;
+  struct frame_slot *slot = &ring->slots[seq % ring->n_slots];
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  slot->timestamp = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  slot->dirty_x = slot->dirty_y = 0;
+  slot->dirty_width = ring->width;
+  slot->dirty_height = ring->height;
+  __atomic_store_n (&slot->seq, seq, __ATOMIC_RELEASE);
+
+  __atomic_store_n (&ring->seq, seq, __ATOMIC_RELEASE);
+  __atomic_store_n (&ring->futex, (uint32_t) seq, __ATOMIC_RELEASE);
+  syscall (SYS_futex, &ring->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void
+frame_ring_close (void)
+{
+  if (!ring)
+    return;
+
+  munmap (ring, ring->size);
+  shm_unlink (ring_name);
+  free (ring_name);
+  ring = NULL;
+  ring_name = NULL;
+}
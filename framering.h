@@ -0,0 +1,72 @@
+/* Shared memory frame ring interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <stdint.h>
+
+/* The frames are published in a POSIX shared memory object that starts
+   with a struct frame_ring, followed by N_SLOTS frames of HEIGHT rows,
+   STRIDE bytes apart, of 32-bit pixels in Cairo's ARGB32 format (that
+   is 0xAARRGGBB in the machine's byte order).  Frame number SEQ, counting
+   from 1, goes in slot SEQ % N_SLOTS.
+
+   A slot's SEQ is zero while the slot is being written.  Readers load
+   it before and after using the frame, and discard the frame if the two
+   values differ.  FUTEX has the low 32 bits of the ring's SEQ and can
+   be waited on with FUTEX_WAIT; it is woken after every frame.  */
+
+#define FRAME_RING_MAGIC	"EVFRAME1"
+#define FRAME_RING_MAX_SLOTS	8
+
+struct frame_slot
+{
+  uint64_t seq;
+  uint64_t timestamp;		/* CLOCK_MONOTONIC nanoseconds when the
+				   frame was finished */
+  uint64_t offset;		/* Of the pixels from the start of the
+				   object */
+
+  /* The rectangle that may differ from the previous frame.  earthview
+     draws whole frames, so this is always the whole frame for now.  */
+  uint32_t dirty_x, dirty_y, dirty_width, dirty_height;
+};
+
+struct frame_ring
+{
+  char magic[8];
+  uint32_t width, height, stride, n_slots;
+  uint64_t size;		/* Of the whole object */
+  uint64_t seq;			/* The last frame, 0 if none */
+  uint32_t futex;
+  uint32_t pad;
+  struct frame_slot slots[FRAME_RING_MAX_SLOTS];
+};
+
+/* Create the shared memory object NAME (for example "/earthview"), with
+   N_SLOTS slots of WIDTH x HEIGHT pixels.  Return 0 on success, -1 on
+   failure.  */
+extern int frame_ring_open (const char *name, int width, int height,
+			    int n_slots);
+
+/* Return the pixels of slot I, whose rows are the ring's STRIDE bytes
+   apart.  */
+extern uint32_t *frame_ring_slot (int i);
+
+/* Return the slot where the next frame is to be drawn.  Readers ignore
+   it until frame_ring_publish is called.  */
+extern int frame_ring_begin (void);
+
+/* Publish the frame that was drawn in the slot that frame_ring_begin
+   returned.  */
+extern void frame_ring_publish (void);
+
+/* Unmap and remove the object.  Readers that mapped it can still
+   read the last frames.  */
+extern void frame_ring_close (void);
+
+#endif /* FRAMERING_H */
@@ -0,0 +1,139 @@
+/* Insolation overlay module.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#include "drawing.h"
+#include "sunrise.h"
+#include "anim.h"
+#include "map.h"
+#include "insolation.h"
+#include "heatmap.h"
+
+/* The products only change from one day to the next, so the overlay is
+   computed with insolation_grid when the day changes and then painted
+   over the map as it is.  Values are mapped to colors with a fixed
+   scale, so that different days can be compared.  */
+
+#define N_COLORS	256
+#define OVERLAY_ALPHA	0.5
+
+enum overlay
+{
+  OVERLAY_NONE, OVERLAY_DAY_LENGTH, OVERLAY_INSOLATION, N_OVERLAYS
+};
+
+static const struct
+{
+  enum insolation_product product;
+  double max;
+  const char *caption;
+} overlays[N_OVERLAYS] = {
+  { 0, 0.0, NULL },
+  { PRODUCT_DAY_LENGTH, 24.0, "Day length, 0 to 24 hours" },
+  { PRODUCT_INSOLATION, 600.0, "Insolation, 0 to 600 W/m^2" }
+};
+
+static enum overlay overlay;
+static cairo_t *heatmap_context;
+static float *values;
+static uint32_t colors[N_COLORS];
+
+static enum overlay cur_overlay;
+static int cur_day = INT_MIN;
+
+/* Blue through cyan, green and yellow to red.  */
+static void
+init_colors (void)
+{
+  static const unsigned char stops[5][3] = {
+    { 0, 0, 160 }, { 0, 200, 255 }, { 0, 200, 0 }, { 255, 230, 0 },
+    { 230, 0, 0 }
+  };
+  int i, k;
+
+  for (i = 0; i < N_COLORS; i++)
+    {
+      int pos = i * 4 * 256 / N_COLORS;
+      int s = pos >> 8, f = pos & 255;
+      uint32_t rgb = 0;
+
+      for (k = 0; k < 3; k++)
+	rgb = (rgb << 8) | ((stops[s][k] * (256 - f) + stops[s + 1][k] * f) >> 8);
+      colors[i] = 0xFF000000 | rgb;
+    }
+}
+
+static void
+update_heatmap (const struct time *t)
+{
+  cairo_surface_t *surface = cairo_get_target (heatmap_context);
+  int stride = cairo_image_surface_get_stride (surface);
+  unsigned char *data;
+  double scale = N_COLORS / overlays[overlay].max;
+  int x, y;
+
+  insolation_grid (overlays[overlay].product, WIN_WIDTH, WIN_HEIGHT,
+		   t->year, t->month, t->day, 1, 0, values);
+
+  cairo_surface_flush (surface);
+  data = cairo_image_surface_get_data (surface);
+  for (y = 0; y < WIN_HEIGHT; y++)
+    {
+      uint32_t *row = (uint32_t *) (data + y * stride);
+      const float *v = values + y * WIN_WIDTH;
+      for (x = 0; x < WIN_WIDTH; x++)
+	{
+	  int c = v[x] * scale;
+	  row[x] = colors[c < 0 ? 0 : c >= N_COLORS ? N_COLORS - 1 : c];
+	}
+    }
+  cairo_surface_mark_dirty (surface);
+}
+
+void
+do_heatmap (cairo_t *cairo_context, SDL_Event *event)
+{
+  int day;
+
+  if (event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_i)
+    overlay = (overlay + 1) % N_OVERLAYS;
+
+  if (overlay == OVERLAY_NONE || !map_equirectangular ())
+    return;
+
+  if (!heatmap_context)
+    {
+      heatmap_context = create_cairo_context ();
+      values = malloc (WIN_WIDTH * WIN_HEIGHT * sizeof (float));
+      if (!values)
+	abort ();
+      init_colors ();
+    }
+
+  day = days_this_millennium (cur_time.year, cur_time.month, cur_time.day);
+  if (day != cur_day || overlay != cur_overlay)
+    {
+      update_heatmap (&cur_time);
+      cur_day = day;
+      cur_overlay = overlay;
+    }
+
+  cairo_save (cairo_context);
+  cairo_set_source_surface (cairo_context, cairo_get_target (heatmap_context),
+			    0, 0);
+  cairo_paint_with_alpha (cairo_context, OVERLAY_ALPHA);
+
+  cairo_set_font_size (cairo_context, 10.0);
+  cairo_set_source_rgb (cairo_context, 1.0, 1.0, 1.0);
+  cairo_move_to (cairo_context, 5.0, WIN_HEIGHT - 5.0);
+  cairo_show_text (cairo_context, overlays[overlay].caption);
+  cairo_restore (cairo_context);
+}
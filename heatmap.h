@@ -0,0 +1,17 @@
+/* Insolation overlay interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <cairo.h>
+#include <SDL.h>
+
+/* Draw a map of the day length or of the insolation over the map on
+   every iteration.  The I key cycles between the two and no map.  */
+extern void do_heatmap (cairo_t *, SDL_Event *);
+
+#endif /* HEATMAP_H */
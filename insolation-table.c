@@ -0,0 +1,150 @@
+/* Insolation and day length maps for a range of days.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sunrise.h"
+#include "ephem.h"
+#include "insolation.h"
+
+/* The output is made of raw 32-bit floats in the machine's byte order,
+   one grid for each day (or a single grid with the mean), each with the
+   rows from north to south and the columns from west to east starting
+   at longitude -180.  Grids are computed in batches that take at most
+   BATCH_FLOATS floats, and written in order.  */
+
+#define BATCH_FLOATS	(16 * 1024 * 1024)
+
+static double
+get_time (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr, "Usage: insolation-table [-dem] [-r DEGREES] [-o OUTPUT] YYYY-MM-DD YYYY-MM-DD\n");
+  fprintf (stderr, "Compute maps of the daily mean insolation at the top of the atmosphere,\n");
+  fprintf (stderr, "in W/m^2, for every day in the range, as raw 32-bit floats.\n");
+  fprintf (stderr, "  -d  compute the day length in hours instead\n");
+  fprintf (stderr, "  -e  compute the Sun's position from tables (see ephem-test)\n");
+  fprintf (stderr, "  -m  write a single map with the mean over the range\n");
+  fprintf (stderr, "  -r  size of the grid cells in degrees (default: 0.5)\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  enum insolation_product product = PRODUCT_INSOLATION;
+  FILE *out = stdout;
+  double resolution = 0.5, start, elapsed;
+  int year, month, day, end_year, end_month, end_day;
+  int width, height, n_days, batch_days, j;
+  int mean = 0, use_tables = 0;
+  long long evals = 0;
+  float *grid;
+  int c;
+
+  while ((c = getopt (argc, argv, "demr:o:")) != -1)
+    switch (c)
+      {
+      case 'd':
+	product = PRODUCT_DAY_LENGTH;
+	break;
+      case 'e':
+	use_tables = 1;
+	break;
+      case 'm':
+	mean = 1;
+	break;
+      case 'r':
+	resolution = atof (optarg);
+	if (resolution < 0.01 || resolution > 90.0)
+	  usage ();
+	break;
+      case 'o':
+	out = fopen (optarg, "wb");
+	if (!out)
+	  {
+	    perror (optarg);
+	    exit (1);
+	  }
+	break;
+      default:
+	usage ();
+      }
+
+  if (argc - optind != 2
+      || sscanf (argv[optind], "%d-%d-%d", &year, &month, &day) != 3
+      || sscanf (argv[optind + 1], "%d-%d-%d",
+		 &end_year, &end_month, &end_day) != 3)
+    usage ();
+
+  n_days = days_from_civil (end_year, end_month, end_day)
+    - days_from_civil (year, month, day) + 1;
+  if (n_days <= 0)
+    usage ();
+
+  if (use_tables && ephem_init (year, end_year) != 0)
+    {
+      fprintf (stderr, "insolation-table: cannot build ephemeris tables\n");
+      exit (1);
+    }
+
+  height = (int) (180.0 / resolution + 0.5);
+  width = 2 * height;
+  batch_days = mean ? 1 : BATCH_FLOATS / ((long) width * height);
+  if (batch_days < 1)
+    batch_days = 1;
+  if (batch_days > n_days)
+    batch_days = n_days;
+
+  grid = malloc ((long) batch_days * width * height * sizeof (float));
+  if (!grid)
+    abort ();
+
+  start = get_time ();
+  if (mean)
+    {
+      evals = insolation_grid (product, width, height, year, month, day,
+			       n_days, 1, grid);
+      fwrite (grid, sizeof (float), (long) width * height, out);
+    }
+  else
+    for (j = 0; j < n_days; j += batch_days)
+      {
+	int n = n_days - j < batch_days ? n_days - j : batch_days;
+
+	/* days_this_millennium is linear in the day, so there is no need
+	   to normalize the date.  */
+	evals += insolation_grid (product, width, height, year, month,
+				  day + j, n, 0, grid);
+	if (fwrite (grid, sizeof (float), (long) n * width * height, out)
+	    != (size_t) n * width * height)
+	  break;
+      }
+
+  if (fflush (out) != 0 || ferror (out))
+    {
+      perror ("insolation-table");
+      exit (1);
+    }
+
+  elapsed = get_time () - start;
+  fprintf (stderr, "%d x %d grid, %d days: %lld evaluations in %.3f s, "
+	   "%.4g evaluations/s\n", width, height, n_days, evals, elapsed,
+	   evals / elapsed);
+  return 0;
+}
@@ -0,0 +1,187 @@
+/* Insolation and day length maps.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sunrise.h"
+#include "degtrig.h"
+#include "parallel.h"
+#include "insolation.h"
+
+/* Both products only depend on the Sun's declination and distance, which
+   calc_sun_day computes once for each day and column, and on the sine
+   and cosine of the latitude, which are computed once for each row.
+   What is left for each point is a division and an arc cosine, and the
+   arc cosines of a whole column are computed at once with acosd_array.
+
+   The grid is split in tiles of a few columns, which are computed in
+   parallel.  Each tile goes through the days in the outer loop and
+   through its columns in the inner loop, so that when computing the
+   mean the sums for the whole tile stay in the cache.  */
+
+#define SOLAR_CONSTANT	1361.0	/* Watts per square meter at 1 AU */
+
+/* At most this many columns per tile; fewer are used if needed to
+   keep all the threads busy.  */
+#define MAX_TILE_COLUMNS 16
+#define TILES_PER_THREAD 4
+
+struct job
+{
+  enum insolation_product product;
+  int width, height;
+  int year, month, day, n_days;
+  int mean;
+  float *out;
+  int tile_columns;
+  double *slat, *clat;
+};
+
+/* Store in VAL the product for all the rows of a column, given the
+   Sun's position in SD.  COST is scratch space.  */
+static void
+compute_column (const struct job *job, const struct sun_day *sd,
+		double *cost, double *val)
+{
+  const double *slat = job->slat, *clat = job->clat;
+  int y, h = job->height;
+
+  switch (job->product)
+    {
+    case PRODUCT_DAY_LENGTH:
+      {
+	/* Like calc_day_length, for the upper limb of the Sun.  */
+	double salt = sind (-35.0 / 60.0 - 0.2666 / sd->sr);
+	for (y = 0; y < h; y++)
+	  {
+	    double c = (salt - slat[y] * sd->sdec) / (clat[y] * sd->cdec);
+	    cost[y] = c > 1.0 ? 1.0 : c < -1.0 ? -1.0 : c;
+	  }
+
+	acosd_array (cost, val, h);
+	for (y = 0; y < h; y++)
+	  val[y] *= 2.0 / 15.0;
+	break;
+      }
+
+    case PRODUCT_INSOLATION:
+      {
+	/* The mean over a day of the cosine of the Sun's zenith angle is
+	   (H0 sin (LAT) sin (DEC) + cos (LAT) cos (DEC) sin (H0)) / PI,
+	   where H0 is the hour angle at sunset, in radians.  */
+	double k = SOLAR_CONSTANT / (M_PI * sd->sr * sd->sr);
+	for (y = 0; y < h; y++)
+	  {
+	    double c = -(slat[y] * sd->sdec) / (clat[y] * sd->cdec);
+	    cost[y] = c > 1.0 ? 1.0 : c < -1.0 ? -1.0 : c;
+	  }
+
+	acosd_array (cost, val, h);
+	for (y = 0; y < h; y++)
+	  val[y] = k * (val[y] * DEG_RAD * slat[y] * sd->sdec
+			+ clat[y] * sd->cdec * sqrt (1.0 - cost[y] * cost[y]));
+	break;
+      }
+
+    default:
+      abort ();
+    }
+}
+
+static void
+compute_tile (int i, void *data)
+{
+  const struct job *job = (const struct job *) data;
+  int w = job->width, h = job->height;
+  int x0 = i * job->tile_columns;
+  int x1 = x0 + job->tile_columns < w ? x0 + job->tile_columns : w;
+  int n = x1 - x0;
+  double *cost = malloc (2 * h * sizeof (double));
+  double *val = cost + h;
+  double *sum = job->mean ? calloc (n * h, sizeof (double)) : NULL;
+  int j, x, y;
+
+  if (!cost || (job->mean && !sum))
+    abort ();
+
+  for (j = 0; j < job->n_days; j++)
+    for (x = x0; x < x1; x++)
+      {
+	struct sun_day sd;
+
+	/* days_this_millennium is linear in the day, so there is no need
+	   to normalize the date.  */
+	calc_sun_day (job->year, job->month, job->day + j,
+		      -180.0 + (x + 0.5) * 360.0 / w, &sd);
+	compute_column (job, &sd, cost, val);
+
+	if (sum)
+	  for (y = 0; y < h; y++)
+	    sum[y * n + x - x0] += val[y];
+	else
+	  {
+	    float *out = job->out + (long) j * w * h + x;
+	    for (y = 0; y < h; y++)
+	      out[(long) y * w] = val[y];
+	  }
+      }
+
+  if (sum)
+    for (y = 0; y < h; y++)
+      for (x = x0; x < x1; x++)
+	job->out[(long) y * w + x] = sum[y * n + x - x0] / job->n_days;
+
+  free (cost);
+  free (sum);
+}
+
+long long
+insolation_grid (enum insolation_product product, int width, int height,
+		 int year, int month, int day, int n_days, int mean,
+		 float *out)
+{
+  struct job job;
+  double *lat;
+  int y, n_tiles;
+
+  job.product = product;
+  job.width = width;
+  job.height = height;
+  job.year = year;
+  job.month = month;
+  job.day = day;
+  job.n_days = n_days;
+  job.mean = mean;
+  job.out = out;
+
+  job.tile_columns = width / (parallel_threads () * TILES_PER_THREAD);
+  if (job.tile_columns > MAX_TILE_COLUMNS)
+    job.tile_columns = MAX_TILE_COLUMNS;
+  if (job.tile_columns < 1)
+    job.tile_columns = 1;
+
+  lat = malloc (height * sizeof (double));
+  job.slat = malloc (height * sizeof (double));
+  job.clat = malloc (height * sizeof (double));
+  if (!lat || !job.slat || !job.clat)
+    abort ();
+
+  for (y = 0; y < height; y++)
+    lat[y] = 90.0 - (y + 0.5) * 180.0 / height;
+  sincosd_array (lat, job.slat, job.clat, height);
+
+  n_tiles = (width + job.tile_columns - 1) / job.tile_columns;
+  if (n_days > 0)
+    parallel_for (n_tiles, compute_tile, &job);
+
+  free (lat);
+  free (job.slat);
+  free (job.clat);
+  return (long long) width * height * n_days;
+}
@@ -0,0 +1,30 @@
+/* Insolation and day length maps interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef INSOLATION_H
+#define INSOLATION_H
+
+enum insolation_product
+{
+  PRODUCT_DAY_LENGTH,		/* Sunrise to sunset, hours */
+  PRODUCT_INSOLATION,		/* Daily mean at the top of the atmosphere,
+				   watts per square meter */
+  N_PRODUCTS
+};
+
+/* Compute PRODUCT for N_DAYS days starting at the given date, on a grid
+   of WIDTH x HEIGHT cells covering the whole Earth.  Rows go from north
+   to south and columns from west to east starting at longitude -180;
+   values are computed at the center of each cell.  If MEAN is true,
+   store in OUT the mean over all days (WIDTH * HEIGHT floats), else
+   store one grid per day (N_DAYS * WIDTH * HEIGHT floats).  The work is
+   spread across all processors with parallel_for.  Return the number
+   of points computed, that is WIDTH * HEIGHT * N_DAYS.  */
+extern long long insolation_grid (enum insolation_product product,
+				  int width, int height, int year, int month,
+				  int day, int n_days, int mean, float *out);
+
+#endif /* INSOLATION_H */
@@ -0,0 +1,223 @@
+/* Day/night blending module.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "drawing.h"
+#include "project.h"
+#include "degtrig.h"
+#include "lights.h"
+
+/* The sine of the Sun's altitude at latitude LAT and hour angle H is
+
+       sin (LAT) sin (DEC) + cos (LAT) cos (DEC) cos (H)
+
+   that is A + B cos (H), where A and B only depend on the row and
+   cos (H) only on the column.  The weight of the day map grows smoothly
+   from 0 to 1 as the altitude goes from TWILIGHT_LOW to TWILIGHT_HIGH.
+
+   Because cos (H) decreases as the distance from the subsolar meridian
+   grows, each row is made of a day span around the subsolar meridian,
+   a night span on the opposite side, and two twilight spans in between.
+   The limits of the spans can be found from the inverse cosine, and
+   only the twilight spans need to be blended pixel by pixel.  */
+
+#define TWILIGHT_LOW	(-6.0)
+#define TWILIGHT_HIGH	(-35.0 / 60.0 - 0.2666)
+
+static float cos_h[WIN_WIDTH];
+
+/* Like degtrig.c, use GCC's generic vectors.  */
+
+#ifdef __AVX2__
+#define VLEN 8
+#else
+#define VLEN 4
+#endif
+
+typedef int32_t vint __attribute__ ((vector_size (VLEN * sizeof (int32_t))));
+typedef uint32_t vuint __attribute__ ((vector_size (VLEN * sizeof (int32_t))));
+typedef float vfloat __attribute__ ((vector_size (VLEN * sizeof (float))));
+
+#define SPLAT(x) ((vfloat) { } + (x))
+
+/* Mix the color components of pixels D and N with weights W and
+   256 - W, and make the result opaque.  Works on both integers and
+   vectors.  */
+#define MIX(d, n, w) \
+  (((((d) & 0xFF00FF) * (w) + ((n) & 0xFF00FF) * (256 - (w))) >> 8 & 0xFF00FF) \
+   | ((((d) & 0xFF00) * (w) + ((n) & 0xFF00) * (256 - (w))) >> 8 & 0xFF00) \
+   | 0xFF000000)
+
+/* Blend the pixels from X0 to X1 - 1 of one row, where the sine of
+   the altitude is A + B * COS_H[X].  */
+static void
+blend_span (uint32_t *dst, const uint32_t *day, const uint32_t *night,
+	    int x0, int x1, float a, float b)
+{
+  const float lo = sind (TWILIGHT_LOW);
+  const float scale = 1.0 / (sind (TWILIGHT_HIGH) - lo);
+  int x;
+
+  for (x = x0; x + VLEN <= x1; x += VLEN)
+    {
+      vfloat c, t;
+      vuint d, n, w;
+      vint m;
+
+      memcpy (&c, cos_h + x, sizeof (c));
+      t = (SPLAT (a) + SPLAT (b) * c - SPLAT (lo)) * SPLAT (scale);
+      m = t > SPLAT (1.0f);
+      t = (vfloat) (((vint) t & ~m) | ((vint) SPLAT (1.0f) & m));
+      t = (vfloat) ((vint) t & (t > SPLAT (0.0f)));
+      t = t * t * (SPLAT (3.0f) - SPLAT (2.0f) * t) * SPLAT (256.0f);
+      w = __builtin_convertvector (t, vuint);
+
+      memcpy (&d, day + x, sizeof (d));
+      memcpy (&n, night + x, sizeof (n));
+      d = MIX (d, n, w);
+      memcpy (dst + x, &d, sizeof (d));
+    }
+
+  for (; x < x1; x++)
+    {
+      float t = (a + b * cos_h[x] - lo) * scale;
+      uint32_t w;
+
+      t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+      w = t * t * (3.0f - 2.0f * t) * 256.0f;
+      dst[x] = MIX (day[x], night[x], w);
+    }
+}
+
+enum span
+{
+  SPAN_NIGHT, SPAN_TWILIGHT, SPAN_DAY
+};
+
+/* Fill the span from V0 to V1 - 1 of one row.  V0 and V1 are
+   columns of a map that repeats every WIN_WIDTH pixels.  */
+static void
+do_span (enum span kind, uint32_t *dst, const uint32_t *day,
+	 const uint32_t *night, int v0, int v1, float a, float b)
+{
+  int x0, x1;
+
+  if (v0 >= v1)
+    return;
+
+  x0 = v0 % WIN_WIDTH;
+  if (x0 < 0)
+    x0 += WIN_WIDTH;
+  x1 = x0 + (v1 - v0);
+  if (x1 > WIN_WIDTH)
+    {
+      do_span (kind, dst, day, night, x0, WIN_WIDTH, a, b);
+      do_span (kind, dst, day, night, 0, x1 - WIN_WIDTH, a, b);
+      return;
+    }
+
+  switch (kind)
+    {
+    case SPAN_NIGHT:
+      memcpy (dst + x0, night + x0, (x1 - x0) * sizeof (uint32_t));
+      break;
+    case SPAN_TWILIGHT:
+      blend_span (dst, day, night, x0, x1, a, b);
+      break;
+    case SPAN_DAY:
+      memcpy (dst + x0, day + x0, (x1 - x0) * sizeof (uint32_t));
+      break;
+    }
+}
+
+/* Return the largest hour angle, in pixels, at which cos (H) is at
+   least C; -1 if there is none and WIN_WIDTH if any H is okay.  */
+static double
+hour_angle_pixels (double c)
+{
+  if (c > 1.0)
+    return -1.0;
+  if (c <= -1.0)
+    return WIN_WIDTH;
+  return acosd (c) * WIN_WIDTH / 360.0;
+}
+
+void
+blend_day_night (uint32_t *dst, const uint32_t *day, const uint32_t *night,
+		 int stride, double sun_lat, double sun_lon)
+{
+  double sdec, cdec, lo, hi, xs;
+  int x, y, v0;
+
+  sincosd (sun_lat, &sdec, &cdec);
+  lo = sind (TWILIGHT_LOW);
+  hi = sind (TWILIGHT_HIGH);
+  for (x = 0; x < WIN_WIDTH; x++)
+    cos_h[x] = cosd (project_x (x) - sun_lon);
+
+  /* Columns are numbered starting half a turn before the subsolar
+     meridian, at column XS.  */
+  xs = (sun_lon + 180.0) * WIN_WIDTH / 360.0;
+  v0 = (int) floor (xs) - WIN_WIDTH / 2;
+
+  for (y = 0; y < WIN_HEIGHT; y++)
+    {
+      uint32_t *d = (uint32_t *) ((char *) dst + y * stride);
+      const uint32_t *dm = (const uint32_t *) ((const char *) day + y * stride);
+      const uint32_t *nm = (const uint32_t *) ((const char *) night
+					       + y * stride);
+      double slat, clat, a, b, hd, hn;
+      int n1, d1, d2, n2, v1 = v0 + WIN_WIDTH;
+
+      sincosd (project_y (y), &slat, &clat);
+      a = slat * sdec;
+      b = clat * cdec;
+
+      /* Find the hour angles where day and night begin; near the poles
+	 the whole row might be in the same state.  Keep a pixel of
+	 margin on each side against rounding errors.  */
+      if (b < 1e-9)
+	{
+	  hd = a >= hi ? WIN_WIDTH : -1.0;
+	  hn = a <= lo ? -1.0 : WIN_WIDTH;
+	}
+      else
+	{
+	  hd = hour_angle_pixels ((hi - a) / b);
+	  hn = hour_angle_pixels ((lo - a) / b);
+	}
+
+      d1 = (int) floor (xs - hd) + 2;
+      d2 = (int) ceil (xs + hd) - 1;
+      n1 = (int) ceil (xs - hn) - 2;
+      n2 = (int) floor (xs + hn) + 3;
+
+      if (d1 < v0)
+	d1 = v0;
+      if (d2 > v1)
+	d2 = v1;
+      if (d1 > d2)
+	d1 = d2 = (int) floor (xs);
+      if (n1 < v0)
+	n1 = v0;
+      if (n1 > d1)
+	n1 = d1;
+      if (n2 > v1)
+	n2 = v1;
+      if (n2 < d2)
+	n2 = d2;
+
+      do_span (SPAN_NIGHT, d, dm, nm, v0, n1, a, b);
+      do_span (SPAN_TWILIGHT, d, dm, nm, n1, d1, a, b);
+      do_span (SPAN_DAY, d, dm, nm, d1, d2, a, b);
+      do_span (SPAN_TWILIGHT, d, dm, nm, d2, n2, a, b);
+      do_span (SPAN_NIGHT, d, dm, nm, n2, v1, a, b);
+    }
+}
@@ -0,0 +1,21 @@
+/* Day/night blending interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <stdint.h>
+
+/* Draw on DST the map DAY where the Sun is up and the map NIGHT (for
+   example, showing city lights) where it is down, fading from one to
+   the other during twilight.  The maps have the size of the window and
+   use the projection of project.h.  All rows are STRIDE bytes apart.
+   SUN_LAT and SUN_LON give the subsolar point.  */
+extern void blend_day_night (uint32_t *dst, const uint32_t *day,
+			     const uint32_t *night, int stride,
+			     double sun_lat, double sun_lon);
+
+#endif /* LIGHTS_H */
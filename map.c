@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <sys/types.h>
 #include <stdio.h>
@@ -18,148 +19,83 @@
 #include "project.h"
 #include "map.h"
 #include "anim.h"
+#include "contour.h"
+#include "terminator.h"
+#include "prefetch.h"
+#include "reproject.h"
+#include "lights.h"
 
 
-/* Marching squares implementation.  */
+/* Whether full traces are done with contour_trace_tiles.  Toggled
+   with the P key, and only used by the main thread; the producer of
+   prefetch.c gets it from prefetch_frame.  */
+static int parallel_contours;
 
-enum dir {
-  UP, LT, DN, RT
-};
-
-/* Bit 3 = top left
-   bit 2 = top right
-   bit 1 = bottom left
-   bit 0 = bottom right.  */
-
-static const int next_square[16] = {
-  RT, /* | | | */		DN, /* | |.| */
-  LT, /* |.| | */		LT, /* |.|.| */
-  RT, /* | |'| */		DN, /* | |:| */
-  LT, /* |.|'| */		LT, /* |.|:| */
-  UP, /* |'| | */		UP, /* |'|.| */
-  UP, /* |:| | */		UP, /* |:|.| */
-  RT, /* |'|'| */		DN, /* |'|:| */
-  RT, /* |:|'| */		RT  /* |:|:| */
+struct map_tracker
+{
+  struct terminator *civil, *sun;
 };
 
-static inline int shift (enum dir d, int x)
+struct map_tracker *
+new_map_tracker (void)
 {
-  switch (d)
-    {
-    case UP: return (x & 0xC) >> 2;
-    case DN: return (x & 0x3) << 2;
-    case LT: return (x & 0xA) >> 1;
-    case RT: return (x & 0x5) << 1;
-    default: abort ();
-    }
-}
-
+  struct map_tracker *mt = calloc (1, sizeof (struct map_tracker));
+  double lon[WIN_WIDTH], lat[WIN_HEIGHT];
+  int i;
 
-typedef int sun_rise_set_fn (int, int, int, double, double, double *, double *);
+  if (!mt)
+    abort ();
 
-static inline int has_daylight (int x, int y, void *data)
-{
-  sun_rise_set_fn *f = (sun_rise_set_fn *) data;
-  double lon = project_x (x);
-  double lat = project_y (y);
-  double rise, set;
-  double hm = cur_time.h + cur_time.m / 60.0;
+  for (i = 0; i < WIN_WIDTH; i++)
+    lon[i] = project_x (i);
+  for (i = 0; i < WIN_HEIGHT; i++)
+    lat[i] = project_y (i);
 
-  switch (f (cur_time.year, cur_time.month, cur_time.day, lon, lat, &rise, &set))
-    {
-    case -1:
-      return 0;
-    case 1:
-      return 1;
-    default:
-      return ((hm > rise && hm < set)
-	      || (hm + 24 > rise && hm + 24 < set)
-	      || (hm - 24 > rise && hm - 24 < set));
-    }
+  mt->civil = new_terminator (civil_rise_set, WIN_WIDTH, WIN_HEIGHT, lon, lat);
+  mt->sun = new_terminator (sun_rise_set, WIN_WIDTH, WIN_HEIGHT, lon, lat);
+  return mt;
 }
 
-static int inside (int x, int y, void *data)
+void
+trace_map (struct map_tracker *mt, const struct time *t, int parallel,
+	   struct map_frame *frame)
 {
-  if (y < -5 || y >= WIN_HEIGHT + 5 || x < -5 || x >= WIN_WIDTH + 5)
-    return 0;
-
-  if (y < 0)
-    y = 0;
-  if (y >= WIN_HEIGHT)
-    y = WIN_HEIGHT - 1;
-
-  if (x < 0)
-    x = 0;
-  if (x >= WIN_WIDTH)
-    x = WIN_WIDTH - 1;
-
-  return has_daylight (x, y, data);
+  double hours = t->h + t->m / 60.0;
+
+  frame->time = *t;
+  terminator_set_parallel (mt->civil, parallel);
+  terminator_set_parallel (mt->sun, parallel);
+  trace_terminator (mt->civil, t->year, t->month, t->day, hours,
+		    &frame->civil);
+  trace_terminator (mt->sun, t->year, t->month, t->day, hours,
+		    &frame->sun);
 }
 
-#define BAD -151515151
 
-static int marching_squares (cairo_t *cairo_context, int x, int y,
-			     int (*fn) (int, int, void *), void *data)
-{
-  int unknown_points = 15;
-  int inside_points = 0;
-  int hit = 0, startx = BAD, starty = BAD;
-  int went_inside = 0;
+static cairo_t *map_context;
+static struct map_tracker *map_tracker;
+static struct map_frame map_frame;
 
-  for (;;)
-    {
-      enum dir dir;
-
-      /* Bit 3 = top left
-         bit 2 = top right
-         bit 1 = bottom left
-         bit 0 = bottom right.  */
-      if ((unknown_points & 1) && fn (x + 1, y + 1, data))
-	inside_points |= 1;
-      if ((unknown_points & 2) && fn (x, y + 1, data))
-	inside_points |= 2;
-      if ((unknown_points & 4) && fn (x + 1, y, data))
-	inside_points |= 4;
-      if ((unknown_points & 8) && fn (x, y, data))
-	inside_points |= 8;
-
-      if (hit || (inside_points != 0 && inside_points != 15))
-        {
-	  if (x >= 0 && x < WIN_WIDTH && y >= 0 && y < WIN_HEIGHT)
-	    went_inside = 1;
-
-	  if (!hit)
-	    {
-	      startx = x, starty = y;
-	      cairo_move_to (cairo_context, x, y);
-	    }
-	  else
-	    {
-	      if (startx == x && starty == y)
-	        break;
-	      cairo_line_to (cairo_context, x, y);
-	    }
-	  hit = 1;
-	}
-
-      dir = next_square[inside_points];
-      switch (dir)
-	{
-	case UP: y--; break;
-	case DN: y++; break;
-	case LT: x--; break;
-	case RT: x++; break;
-	}
-
-      unknown_points = shift (dir, 15) ^ 15;
-      inside_points = shift (dir, inside_points);
-    }
+/* The views that the V key cycles through.  Only the first one uses
+   the contours; the others go through reproject.c.  */
+enum view
+{
+  VIEW_MAP,
+  VIEW_GLOBE_SUN,		/* Globe centered on the subsolar point */
+  VIEW_GLOBE,
+  VIEW_ROBINSON,
+  VIEW_POLAR_NORTH,
+  VIEW_POLAR_SOUTH,
+  N_VIEWS
+};
 
-  return went_inside;
-}
+static enum view view;
+static double view_lat, view_lon;
 
-
-static cairo_t *map_context;
+/* If night.png exists, the night side shows it instead of a darker
+   map.png.  Toggled with the N key.  */
+static cairo_t *night_context;
+static int night_lights;
 
 void
 init_map (void)
@@ -169,47 +105,41 @@ init_map (void)
   cairo_set_source_surface (map_context, png_map, 0, 0);
   cairo_paint (map_context);
   cairo_surface_destroy (png_map);
+  map_tracker = new_map_tracker ();
+
+  cairo_surface_flush (cairo_get_target (map_context));
+  reproject_init ((const uint32_t *)
+		  cairo_image_surface_get_data (cairo_get_target (map_context)),
+		  cairo_image_surface_get_stride (cairo_get_target (map_context)));
+
+  png_map = cairo_image_surface_create_from_png ("night.png");
+  if (cairo_surface_status (png_map) == CAIRO_STATUS_SUCCESS)
+    {
+      night_context = create_cairo_context ();
+      cairo_set_source_surface (night_context, png_map, 0, 0);
+      cairo_paint (night_context);
+      cairo_surface_flush (cairo_get_target (night_context));
+      night_lights = 1;
+    }
+  cairo_surface_destroy (png_map);
 }
 
 void
-render_map_marching_squares (cairo_t *cairo_context, sun_rise_set_fn *f,
+render_map_marching_squares (cairo_t *cairo_context, const struct contour *c,
 			     double alpha)
 {
+  int i, j;
+
   cairo_save (cairo_context);
   cairo_new_path (cairo_context);
-
-  /* This is a little hackish.  Sometime the civil twilight's shape is
-     a rectangle with a "hole" in it.  In this case, several interesting
-     things happen:
-
-     1) we know that the first marching squares pass will trace a rectangle,
-        because it will just go around the borders
-
-     2) however, we know that we can trace the hole, if we start *inside*
-        the map (i.e.  inside the lit part!) and we don't consider the
-        borders at all.
-
-     3) we know that both the rectangle and the hole are traced in the
-        same direction, so that the if we trace both the even/odd rule
-        will indeed generate a rectangle with a hole:
-
-                             .----.
-                            |2222222|
-                 .----------+-2-2-2-+----.
-                 |1111111111|2222222|1111.
-                 |1111111111|2222222|1111.
-                 |1111111111'-------'1111.
-                 |11111111111111111111111.
-                 '-----------------------'
-
-     So marching_squares returns false if it never enters the map, and in
-     this case we call it again with a slightly different function that will
-     trace the inside shape without regards for border.  */
-
-  if (!marching_squares (cairo_context, -60, project_lat (0.0),
-			 inside, (void *) f))
-    marching_squares (cairo_context, 3, project_lat (0.0),
-		      has_daylight, (void *) f);
+  for (i = 0; i < c->n_rings; i++)
+    {
+      int end = (i + 1 < c->n_rings ? c->rings[i + 1] : c->n_pts);
+      j = c->rings[i];
+      cairo_move_to (cairo_context, c->pts[j].x, c->pts[j].y);
+      while (++j < end)
+	cairo_line_to (cairo_context, c->pts[j].x, c->pts[j].y);
+    }
 
   cairo_close_path (cairo_context);
 
@@ -222,15 +152,154 @@ render_map_marching_squares (cairo_t *cairo_context, sun_rise_set_fn *f,
   cairo_restore (cairo_context);
 }
 
+int
+map_equirectangular (void)
+{
+  return view == VIEW_MAP;
+}
+
+/* Draw the map for views other than VIEW_MAP.  The subsolar point
+   gives the day/night boundaries, so no contour is needed.  */
+
+static void
+render_map_reprojected (cairo_t *cairo_context)
+{
+  cairo_surface_t *surface = cairo_get_target (cairo_context);
+  double sun_lat, sun_lon, lon = view_lon;
+
+  calc_subsolar_point (cur_time.year, cur_time.month, cur_time.day,
+		       cur_time.h + cur_time.m / 60.0, &sun_lat, &sun_lon);
+
+  switch (view)
+    {
+    case VIEW_GLOBE_SUN:
+      /* The tilt of the globe changes slowly; rounding it avoids
+	 rebuilding the lookup tables on every frame.  */
+      reproject_set_view (PROJ_ORTHOGRAPHIC, rint (sun_lat));
+      lon = sun_lon;
+      break;
+    case VIEW_GLOBE:
+      reproject_set_view (PROJ_ORTHOGRAPHIC, view_lat);
+      break;
+    case VIEW_ROBINSON:
+      reproject_set_view (PROJ_ROBINSON, 0.0);
+      break;
+    case VIEW_POLAR_NORTH:
+      reproject_set_view (PROJ_POLAR_NORTH, 0.0);
+      break;
+    case VIEW_POLAR_SOUTH:
+      reproject_set_view (PROJ_POLAR_SOUTH, 0.0);
+      break;
+    default:
+      abort ();
+    }
+
+  cairo_surface_flush (surface);
+  reproject_render ((uint32_t *) cairo_image_surface_get_data (surface),
+		    cairo_image_surface_get_stride (surface),
+		    lon, sun_lat, sun_lon);
+  cairo_surface_mark_dirty (surface);
+}
+
+/* Draw the map with the night side taken from night.png.  */
+
+static void
+render_map_lights (cairo_t *cairo_context)
+{
+  cairo_surface_t *surface = cairo_get_target (cairo_context);
+  cairo_surface_t *day = cairo_get_target (map_context);
+  cairo_surface_t *night = cairo_get_target (night_context);
+  double sun_lat, sun_lon;
+
+  calc_subsolar_point (cur_time.year, cur_time.month, cur_time.day,
+		       cur_time.h + cur_time.m / 60.0, &sun_lat, &sun_lon);
+
+  cairo_surface_flush (surface);
+  blend_day_night ((uint32_t *) cairo_image_surface_get_data (surface),
+		   (const uint32_t *) cairo_image_surface_get_data (day),
+		   (const uint32_t *) cairo_image_surface_get_data (night),
+		   cairo_image_surface_get_stride (surface), sun_lat, sun_lon);
+  cairo_surface_mark_dirty (surface);
+}
+
 void
 do_map (cairo_t *cairo_context, SDL_Event *event)
 {
+  struct map_frame *frame;
+
+  if (event->type == SDL_KEYDOWN)
+    switch (event->key.keysym.sym)
+      {
+      case SDLK_p:
+	/* The frames computed in advance used the other mode.  */
+	parallel_contours = !parallel_contours;
+	prefetch_invalidate ();
+	break;
+
+      case SDLK_n:
+	if (night_context)
+	  night_lights = !night_lights;
+	break;
+
+      case SDLK_v:
+	view = (view + 1) % N_VIEWS;
+	break;
+
+      case SDLK_LEFT:
+	view_lon -= 15.0;
+	break;
+      case SDLK_RIGHT:
+	view_lon += 15.0;
+	break;
+      case SDLK_UP:
+	if (view_lat < 90.0)
+	  view_lat += 10.0;
+	break;
+      case SDLK_DOWN:
+	if (view_lat > -90.0)
+	  view_lat -= 10.0;
+	break;
+
+      case SDLK_s:
+      case SDLK_EQUALS:
+      case SDLK_RETURN:
+	/* The time will not follow the frames that are being computed
+	   in advance.  */
+	prefetch_invalidate ();
+	break;
+
+      default:
+	break;
+      }
+
+  if (view != VIEW_MAP)
+    {
+      render_map_reprojected (cairo_context);
+      return;
+    }
+
+  if (night_lights)
+    {
+      render_map_lights (cairo_context);
+      return;
+    }
+
+  frame = prefetch_frame (&cur_time, parallel_contours);
+  if (!frame)
+    {
+      frame = &map_frame;
+      trace_map (map_tracker, &cur_time, parallel_contours, frame);
+    }
+
   cairo_save (cairo_context);
   cairo_set_operator (cairo_context, CAIRO_OPERATOR_SOURCE);
   cairo_set_source_surface (cairo_context, cairo_get_target (map_context), 0, 0);
   cairo_paint (cairo_context);
   cairo_restore (cairo_context);
 
-  render_map_marching_squares (cairo_context, civil_rise_set, 0.25);
-  render_map_marching_squares (cairo_context, sun_rise_set, 0.33);
+  render_map_marching_squares (cairo_context, &frame->civil, 0.25);
+  render_map_marching_squares (cairo_context, &frame->sun, 0.33);
+
+  if (frame != &map_frame)
+    prefetch_release ();
 }
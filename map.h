@@ -10,9 +10,33 @@
 #include <cairo.h>
 #include <SDL.h>
 
+#include "anim.h"
+#include "contour.h"
+
+/* The day/night boundaries for one frame.  */
+struct map_frame
+{
+  struct time time;
+  struct contour civil, sun;
+};
+
+/* State used to trace the boundaries efficiently from one frame to
+   the next.  Each thread that traces frames needs its own.  */
+struct map_tracker;
+
+extern struct map_tracker *new_map_tracker (void);
+
+/* Trace the day/night boundaries at time T into FRAME.  If PARALLEL
+   is nonzero, full traces use all the threads of parallel_for.  */
+extern void trace_map (struct map_tracker *, const struct time *t,
+		       int parallel, struct map_frame *frame);
+
 /* Initialize the rendering of the map.  */
 extern void init_map (void);
 
+/* Return whether the map is drawn in the projection of project.h.  */
+extern int map_equirectangular (void);
+
 /* Render the map on every iteration.  */
 extern void do_map (cairo_t *, SDL_Event *);
 
@@ -0,0 +1,123 @@
+/* Thread pool.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "parallel.h"
+
+#define MAX_THREADS 64
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+static int n_threads = 1;
+
+/* The job that is being run.  GENERATION is incremented whenever a new
+   job is posted, so that the workers can tell it from the previous one.  */
+static void (*job_fn) (int, void *);
+static void *job_data;
+static int job_n, job_next, job_running;
+static unsigned generation;
+
+/* Take indices from the current job and run them, until there are
+   no more.  Called with MUTEX held.  */
+static void
+run_job (void)
+{
+  while (job_next < job_n)
+    {
+      int i = job_next++;
+      pthread_mutex_unlock (&mutex);
+      job_fn (i, job_data);
+      pthread_mutex_lock (&mutex);
+    }
+}
+
+static void *
+worker (void *arg __attribute__ ((unused)))
+{
+  unsigned seen = 0;
+
+  pthread_mutex_lock (&mutex);
+  for (;;)
+    {
+      while (generation == seen)
+	pthread_cond_wait (&work_cond, &mutex);
+
+      seen = generation;
+      job_running++;
+      run_job ();
+      if (--job_running == 0)
+	pthread_cond_signal (&done_cond);
+    }
+
+  return NULL;
+}
+
+static void
+init_threads (void)
+{
+  const char *env = getenv ("EARTHVIEW_THREADS");
+  pthread_t thread;
+  int i;
+
+  n_threads = env ? atoi (env) : sysconf (_SC_NPROCESSORS_ONLN);
+  if (n_threads < 1)
+    n_threads = 1;
+  if (n_threads > MAX_THREADS)
+    n_threads = MAX_THREADS;
+
+  for (i = 1; i < n_threads; i++)
+    if (pthread_create (&thread, NULL, worker, NULL) != 0)
+      {
+	n_threads = i;
+	break;
+      }
+}
+
+int
+parallel_threads (void)
+{
+  pthread_once (&init_once, init_threads);
+  return n_threads;
+}
+
+void
+parallel_for (int n, void (*fn) (int, void *), void *data)
+{
+  int i;
+
+  if (parallel_threads () == 1 || n <= 1)
+    {
+      for (i = 0; i < n; i++)
+	fn (i, data);
+      return;
+    }
+
+  pthread_mutex_lock (&job_mutex);
+  pthread_mutex_lock (&mutex);
+  job_fn = fn;
+  job_data = data;
+  job_n = n;
+  job_next = 0;
+  job_running = 1;
+  generation++;
+  pthread_cond_broadcast (&work_cond);
+
+  run_job ();
+  job_running--;
+  while (job_running > 0)
+    pthread_cond_wait (&done_cond, &mutex);
+
+  pthread_mutex_unlock (&mutex);
+  pthread_mutex_unlock (&job_mutex);
+}
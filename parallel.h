@@ -0,0 +1,20 @@
+/* Thread pool interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/* Return the number of threads that parallel_for uses, including
+   the calling thread.  */
+extern int parallel_threads (void);
+
+/* Call FN (I, DATA) for every I between 0 and N - 1, spreading the
+   calls across all the processors, and return when all of them have
+   completed.  Only one parallel_for runs at a time; calls from other
+   threads wait for the current one to finish.  */
+extern void parallel_for (int n, void (*fn) (int, void *), void *data);
+
+#endif /* PARALLEL_H */
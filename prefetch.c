@@ -0,0 +1,152 @@
+/* Look-ahead computation of animation frames.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "prefetch.h"
+
+/* When the animation is running, the time of the next frames is known
+   in advance.  A producer thread traces them into a ring buffer, and the
+   main loop takes them from there.  There is a single producer, so this
+   uses at most one core besides the main loop's; each trace can still
+   use the thread pool of parallel.c.  */
+
+#define PREFETCH_FRAMES 8
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ready = PTHREAD_COND_INITIALIZER;
+static int started;
+
+/* Frames HEAD to HEAD + COUNT - 1 are ready, and READY is signaled
+   when one is added.  The producer is working on the time NEXT_TIME,
+   or will as soon as there is room, at speed SPEED and passing
+   PARALLEL to trace_map, unless SPEED is zero.  Every invalidation
+   increments GENERATION, so that the producer knows whether the frame
+   it just traced is still useful.  */
+static struct map_frame ring[PREFETCH_FRAMES];
+static int head, count;
+static struct time next_time;
+static int speed, parallel;
+static unsigned generation;
+
+static int
+same_time (const struct time *a, const struct time *b)
+{
+  return a->year == b->year && a->month == b->month && a->day == b->day
+    && a->h == b->h && a->m == b->m;
+}
+
+static void *
+producer (void *arg __attribute__ ((unused)))
+{
+  struct map_tracker *mt = new_map_tracker ();
+
+  pthread_mutex_lock (&mutex);
+  for (;;)
+    {
+      struct map_frame *frame;
+      struct time t;
+      unsigned gen;
+      int par;
+
+      while (speed == 0 || count == PREFETCH_FRAMES)
+	pthread_cond_wait (&cond, &mutex);
+
+      /* The consumer never looks past the ready frames, so the slot
+	 can be filled without holding the lock.  */
+      frame = &ring[(head + count) % PREFETCH_FRAMES];
+      t = next_time;
+      par = parallel;
+      gen = generation;
+      pthread_mutex_unlock (&mutex);
+
+      trace_map (mt, &t, par, frame);
+
+      pthread_mutex_lock (&mutex);
+      if (gen == generation)
+	{
+	  count++;
+	  anim_step (&next_time, speed);
+	  pthread_cond_signal (&ready);
+	}
+    }
+
+  return NULL;
+}
+
+void
+prefetch_invalidate (void)
+{
+  pthread_mutex_lock (&mutex);
+  generation++;
+  count = 0;
+  speed = 0;
+  pthread_mutex_unlock (&mutex);
+}
+
+struct map_frame *
+prefetch_frame (const struct time *t, int par)
+{
+  int cur_speed = anim_speed ();
+  pthread_t thread;
+
+  /* At speed 0 the time follows the clock, and there is nothing
+     to predict.  */
+  if (cur_speed == 0)
+    {
+      if (speed != 0)
+	prefetch_invalidate ();
+      return NULL;
+    }
+
+  pthread_mutex_lock (&mutex);
+  if (!started)
+    {
+      started = 1;
+      if (pthread_create (&thread, NULL, producer, NULL) != 0)
+	{
+	  pthread_mutex_unlock (&mutex);
+	  return NULL;
+	}
+      pthread_detach (thread);
+    }
+
+  /* If the producer is tracing T, finishing that is faster than
+     starting over.  */
+  if (speed == cur_speed && count == 0 && same_time (&next_time, t))
+    while (count == 0)
+      pthread_cond_wait (&ready, &mutex);
+
+  if (speed == cur_speed && count > 0 && same_time (&ring[head].time, t))
+    {
+      pthread_mutex_unlock (&mutex);
+      return &ring[head];
+    }
+
+  /* Wrong guess, start over from the frame after T.  */
+  generation++;
+  count = 0;
+  speed = cur_speed;
+  parallel = par;
+  next_time = *t;
+  anim_step (&next_time, speed);
+  pthread_cond_signal (&cond);
+  pthread_mutex_unlock (&mutex);
+  return NULL;
+}
+
+void
+prefetch_release (void)
+{
+  pthread_mutex_lock (&mutex);
+  head = (head + 1) % PREFETCH_FRAMES;
+  count--;
+  pthread_cond_signal (&cond);
+  pthread_mutex_unlock (&mutex);
+}
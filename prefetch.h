@@ -0,0 +1,25 @@
+/* Look-ahead computation of animation frames.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "anim.h"
+#include "map.h"
+
+/* Return the day/night boundaries for time T if they were computed in
+   advance, waiting for them if they are being computed.  Otherwise
+   return NULL and start computing the frames that follow T, passing
+   PARALLEL to trace_map.  The frame stays valid until prefetch_release
+   is called.  */
+extern struct map_frame *prefetch_frame (const struct time *t, int parallel);
+extern void prefetch_release (void);
+
+/* Throw away the frames computed so far, because the animation
+   is not going to reach them.  */
+extern void prefetch_invalidate (void);
+
+#endif /* PREFETCH_H */
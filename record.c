@@ -0,0 +1,194 @@
+/* Recording and replay of input.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "anim.h"
+#include "record.h"
+
+/* What earthview draws only depends on its input: the time when it
+   starts, the keys that are pressed and, when following the clock, the
+   time that it reads.  The log has a line for each of them, tagged with
+   the number of the frame where it was read:
+
+	earthview-log 1
+	start YEAR MONTH DAY HOUR MINUTE SPEED
+	clock FRAME SECONDS
+	key FRAME SYMBOL
+	quit FRAME
+
+   Clock lines are only written when the time changes.  */
+
+enum mode
+{
+  MODE_NONE, MODE_RECORD, MODE_REPLAY
+};
+
+static enum mode mode;
+static FILE *log_file;
+static unsigned frame;
+
+/* For recording, the last time that was logged.  For replay, the time
+   that the clock shows.  */
+static time_t clock_value;
+static int have_clock;
+
+/* The next line of the log when replaying; an empty KIND means that
+   the end of the file was reached.  */
+static char next_kind[8];
+static unsigned next_frame;
+static long next_value;
+
+int
+record_open (const char *file)
+{
+  log_file = fopen (file, "w");
+  if (!log_file)
+    return -1;
+
+  mode = MODE_RECORD;
+  fprintf (log_file, "earthview-log 1\n");
+  fprintf (log_file, "start %d %d %d %d %d %d\n", cur_time.year,
+	   cur_time.month, cur_time.day, cur_time.h, cur_time.m,
+	   anim_speed ());
+  return 0;
+}
+
+static void
+read_next (void)
+{
+  char line[80];
+
+  next_kind[0] = 0;
+  while (fgets (line, sizeof (line), log_file))
+    {
+      int n = sscanf (line, "%7s %u %ld", next_kind, &next_frame,
+		      &next_value);
+      if ((n == 3 && (!strcmp (next_kind, "clock")
+		      || !strcmp (next_kind, "key")))
+	  || (n >= 2 && !strcmp (next_kind, "quit")))
+	return;
+
+      fprintf (stderr, "earthview: invalid log line: %s", line);
+      next_kind[0] = 0;
+    }
+}
+
+int
+replay_open (const char *file)
+{
+  char line[80];
+  int speed;
+
+  log_file = fopen (file, "r");
+  if (!log_file)
+    return -1;
+
+  if (!fgets (line, sizeof (line), log_file)
+      || strcmp (line, "earthview-log 1\n") != 0
+      || !fgets (line, sizeof (line), log_file)
+      || sscanf (line, "start %d %d %d %d %d %d", &cur_time.year,
+		 &cur_time.month, &cur_time.day, &cur_time.h, &cur_time.m,
+		 &speed) != 6)
+    {
+      fclose (log_file);
+      return -1;
+    }
+
+  mode = MODE_REPLAY;
+  anim_set_speed (speed);
+  read_next ();
+  return 0;
+}
+
+int
+replaying (void)
+{
+  return mode == MODE_REPLAY;
+}
+
+void
+record_event (SDL_Event *event)
+{
+  frame++;
+  switch (mode)
+    {
+    case MODE_RECORD:
+      if (event->type == SDL_KEYDOWN)
+	fprintf (log_file, "key %u %d\n", frame, (int) event->key.keysym.sym);
+      else if (event->type == SDL_QUIT)
+	fprintf (log_file, "quit %u\n", frame);
+      break;
+
+    case MODE_REPLAY:
+      /* Lines for the same frame can come in any order, because the
+	 clock is read after the event, so process all of them now.  */
+      memset (event, 0, sizeof (SDL_Event));
+      event->type = -1;
+      while (next_kind[0] && next_frame <= frame)
+	{
+	  if (!strcmp (next_kind, "quit"))
+	    {
+	      event->type = SDL_QUIT;
+	      return;
+	    }
+
+	  if (!strcmp (next_kind, "clock"))
+	    {
+	      clock_value = next_value;
+	      have_clock = 1;
+	    }
+	  else
+	    {
+	      event->type = SDL_KEYDOWN;
+	      event->key.keysym.sym = (SDLKey) next_value;
+	    }
+	  read_next ();
+	}
+
+      /* A log that ends without a quit line, for example because
+	 earthview crashed, stops at the end of the file.  */
+      if (!next_kind[0] && event->type != SDL_KEYDOWN)
+	event->type = SDL_QUIT;
+      break;
+
+    default:
+      break;
+    }
+}
+
+time_t
+record_clock (time_t t)
+{
+  switch (mode)
+    {
+    case MODE_RECORD:
+      if (!have_clock || t != clock_value)
+	{
+	  fprintf (log_file, "clock %u %ld\n", frame, (long) t);
+	  clock_value = t;
+	  have_clock = 1;
+	}
+      return t;
+
+    case MODE_REPLAY:
+      return have_clock ? clock_value : t;
+
+    default:
+      return t;
+    }
+}
+
+void
+record_close (void)
+{
+  if (log_file)
+    fclose (log_file);
+  log_file = NULL;
+  mode = MODE_NONE;
+}
@@ -0,0 +1,36 @@
+/* Recording and replay of input interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <time.h>
+#include <SDL.h>
+
+/* Start writing to FILE the current time and animation speed, and then
+   the input read by record_event and record_clock.  Return 0 on
+   success, -1 on failure.  */
+extern int record_open (const char *file);
+
+/* Read the input from FILE, which was written by record_open, and set
+   the current time and animation speed from it.  Return 0 on success,
+   -1 on failure.  */
+extern int replay_open (const char *file);
+
+/* Return whether input comes from replay_open's file.  */
+extern int replaying (void);
+
+/* Call this once per frame with the event read from SDL, if any.
+   When recording, the event is written to the file; when replaying,
+   it is replaced with the one that was recorded for this frame.  */
+extern void record_event (SDL_Event *event);
+
+/* Likewise for the wall clock, whose value is T.  */
+extern time_t record_clock (time_t t);
+
+extern void record_close (void);
+
+#endif /* RECORD_H */
@@ -0,0 +1,98 @@
+/* Map rendering - consistency test program.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "drawing.h"
+#include "degtrig.h"
+#include "reproject.h"
+#include "lights.h"
+
+/* Draw a synthetic map in every view and blend two maps, for the
+   subsolar points of a year at a few times of day, and print a hash of
+   each result.  The output does not depend on the vector instructions
+   that the program was compiled for, so "make check-avx2" compares it
+   between a build for the baseline x86-64 and one for AVX2.  */
+
+#define STRIDE		(WIN_WIDTH * 4)
+
+static uint32_t day[WIN_WIDTH * WIN_HEIGHT];
+static uint32_t night[WIN_WIDTH * WIN_HEIGHT];
+static uint32_t out[WIN_WIDTH * WIN_HEIGHT];
+
+static uint64_t
+hash (const uint32_t *p, int n)
+{
+  uint64_t h = 14695981039346656037ULL;
+  int i;
+
+  for (i = 0; i < n; i++)
+    h = (h ^ p[i]) * 1099511628211ULL;
+  return h;
+}
+
+static uint32_t
+pattern (int x, int y, int seed)
+{
+  uint32_t v = (x * 2654435761U) ^ (y * 2246822519U) ^ (seed * 3266489917U);
+  return (v ^ (v >> 15)) | 0xFF000000;
+}
+
+int
+main (void)
+{
+  static const double center_lat[] = { 0.0, 23.4, -51.0, 89.0 };
+  const int n = WIN_WIDTH * WIN_HEIGHT;
+  int proj, d, h, i, x, y;
+
+  for (y = 0; y < WIN_HEIGHT; y++)
+    for (x = 0; x < WIN_WIDTH; x++)
+      {
+	day[y * WIN_WIDTH + x] = pattern (x, y, 1);
+	night[y * WIN_WIDTH + x] = pattern (x, y, 2);
+      }
+
+  reproject_init (day, STRIDE);
+  for (proj = 0; proj < N_PROJECTIONS; proj++)
+    for (i = 0; i < 4; i++)
+      {
+	uint64_t sum = 0;
+
+	reproject_set_view (proj, center_lat[i]);
+	for (d = 0; d < 365; d += 14)
+	  for (h = 0; h < 24; h += 6)
+	    {
+	      double sun_lat = 23.44 * sind ((d - 80) * 360.0 / 365.25);
+	      double sun_lon = 180.0 - h * 15.0 - d * 0.3;
+
+	      reproject_render (out, STRIDE, d * 7.3 - 180.0, sun_lat, sun_lon);
+	      sum = sum * 31 + hash (out, n);
+	    }
+
+	printf ("==> view %d, center latitude %5.1f: %016llx\n", proj,
+		center_lat[i], (unsigned long long) sum);
+      }
+
+  for (d = 0; d < 365; d += 14)
+    {
+      uint64_t sum = 0;
+
+      for (h = 0; h < 24; h += 6)
+	{
+	  double sun_lat = 23.44 * sind ((d - 80) * 360.0 / 365.25);
+	  double sun_lon = 180.0 - h * 15.0 - d * 0.3;
+
+	  blend_day_night (out, day, night, STRIDE, sun_lat, sun_lon);
+	  sum = sum * 31 + hash (out, n);
+	}
+
+      printf ("==> blend, day %3d: %016llx\n", d, (unsigned long long) sum);
+    }
+
+  return 0;
+}
@@ -0,0 +1,316 @@
+/* Map reprojection module.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "drawing.h"
+#include "project.h"
+#include "degtrig.h"
+#include "reproject.h"
+
+/* Each pixel of the window is looked up in a table, computed when the
+   view changes, that gives the pixel of the map to be drawn there and
+   the position on the Earth as a unit vector.  The latter makes it
+   easy to darken the night side: the sine of the Sun's altitude is
+   just the dot product with the vector pointing to the subsolar point.
+
+   The tables are built with longitudes relative to the central meridian,
+   so that rotating the Earth does not require rebuilding them.  Instead,
+   the map is stored twice side by side, and the rotation becomes an
+   offset into it; the subsolar point is rotated the other way.  */
+
+struct lookup
+{
+  int32_t *src;			/* Index in TEXTURE minus the offset,
+				   or -1 if outside the Earth */
+  float *vx, *vy, *vz;		/* Position on the Earth */
+};
+
+static uint32_t *texture;	/* The map, twice as wide */
+static struct lookup lut;
+static enum projection cur_proj = N_PROJECTIONS;
+static double cur_center_lat;
+
+/* The sine of the altitude at which each of the two shades used by
+   do_map starts, and the fraction (out of 256) of the light that is
+   left.  */
+#define SUN_ALT		(-35.0 / 60.0 - 0.2666)
+#define CIVIL_ALT	(-6.0)
+#define SUN_SHADE	172		/* 1 - 0.33 */
+#define CIVIL_SHADE	129		/* (1 - 0.33) * (1 - 0.25) */
+
+void
+reproject_init (const uint32_t *map, int stride)
+{
+  int y;
+
+  if (!texture)
+    {
+      texture = malloc (2 * WIN_WIDTH * WIN_HEIGHT * sizeof (uint32_t));
+      if (!texture)
+	abort ();
+    }
+
+  for (y = 0; y < WIN_HEIGHT; y++)
+    {
+      const uint32_t *row = (const uint32_t *) ((const char *) map
+						+ y * stride);
+      memcpy (texture + 2 * y * WIN_WIDTH, row,
+	      WIN_WIDTH * sizeof (uint32_t));
+      memcpy (texture + (2 * y + 1) * WIN_WIDTH, row,
+	      WIN_WIDTH * sizeof (uint32_t));
+    }
+}
+
+
+/* Robinson's table of the length of the parallels and of their
+   distance from the equator, every 5 degrees of latitude.  */
+static const double robinson[19][2] = {
+  { 1.0000, 0.0000 }, { 0.9986, 0.0620 }, { 0.9954, 0.1240 },
+  { 0.9900, 0.1860 }, { 0.9822, 0.2480 }, { 0.9730, 0.3100 },
+  { 0.9600, 0.3720 }, { 0.9427, 0.4340 }, { 0.9216, 0.4958 },
+  { 0.8962, 0.5571 }, { 0.8679, 0.6176 }, { 0.8350, 0.6769 },
+  { 0.7986, 0.7346 }, { 0.7597, 0.7903 }, { 0.7186, 0.8435 },
+  { 0.6732, 0.8936 }, { 0.6213, 0.9394 }, { 0.5722, 0.9761 },
+  { 0.5322, 1.0000 }
+};
+
+#define ROBINSON_X	0.8487
+#define ROBINSON_Y	1.3523
+
+/* Compute the latitude and the longitude (relative to the central
+   meridian) shown at the pixel I, J.  Return 0 if the pixel is outside
+   the Earth.  */
+static int
+inverse (enum projection proj, double center_lat, int i, int j,
+	 double *lat, double *lon)
+{
+  double x, y, r, rho;
+  double s0, c0, z, t;
+  int k;
+
+  switch (proj)
+    {
+    case PROJ_ORTHOGRAPHIC:
+      r = (WIN_WIDTH < WIN_HEIGHT ? WIN_WIDTH : WIN_HEIGHT) / 2 - 4;
+      x = (i + 0.5 - WIN_WIDTH / 2.0) / r;
+      y = (WIN_HEIGHT / 2.0 - j - 0.5) / r;
+      rho = x * x + y * y;
+      if (rho > 1.0)
+	return 0;
+
+      z = sqrt (1.0 - rho);
+      sincosd (center_lat, &s0, &c0);
+      *lat = asind (y * c0 + z * s0);
+      *lon = atan2d (x, z * c0 - y * s0);
+      return 1;
+
+    case PROJ_ROBINSON:
+      r = WIN_WIDTH / (2.0 * ROBINSON_X * M_PI);
+      if (r > WIN_HEIGHT / (2.0 * ROBINSON_Y))
+	r = WIN_HEIGHT / (2.0 * ROBINSON_Y);
+      x = (i + 0.5 - WIN_WIDTH / 2.0) / r;
+      y = (WIN_HEIGHT / 2.0 - j - 0.5) / r;
+      z = fabs (y) / ROBINSON_Y;
+      if (z > 1.0)
+	return 0;
+
+      /* Interpolate linearly between the entries of the table.  */
+      for (k = 0; k < 17 && robinson[k + 1][1] <= z; k++)
+	;
+      t = (z - robinson[k][1]) / (robinson[k + 1][1] - robinson[k][1]);
+      *lat = 5.0 * (k + t);
+      *lon = RAD_DEG * x / (ROBINSON_X * (robinson[k][0]
+				      + t * (robinson[k + 1][0] - robinson[k][0])));
+      if (y < 0)
+	*lat = -*lat;
+      return fabs (*lon) <= 180.0;
+
+    case PROJ_POLAR_NORTH:
+    case PROJ_POLAR_SOUTH:
+      r = (WIN_WIDTH < WIN_HEIGHT ? WIN_WIDTH : WIN_HEIGHT) / 2 - 4;
+      x = (i + 0.5 - WIN_WIDTH / 2.0) / r;
+      y = (WIN_HEIGHT / 2.0 - j - 0.5) / r;
+      rho = sqrt (x * x + y * y);
+      if (rho > 1.0)
+	return 0;
+
+      /* The whole Earth is shown, with the distance from the center
+	 proportional to the distance from the pole.  Seen from the
+	 north pole, longitudes grow counterclockwise.  */
+      if (proj == PROJ_POLAR_NORTH)
+	{
+	  *lat = 90.0 - 180.0 * rho;
+	  *lon = atan2d (x, -y);
+	}
+      else
+	{
+	  *lat = -90.0 + 180.0 * rho;
+	  *lon = atan2d (x, y);
+	}
+      return 1;
+
+    default:
+      abort ();
+    }
+}
+
+void
+reproject_set_view (enum projection proj, double center_lat)
+{
+  int i, j, n;
+
+  if (proj != PROJ_ORTHOGRAPHIC)
+    center_lat = 0.0;
+  if (proj == cur_proj && center_lat == cur_center_lat)
+    return;
+
+  cur_proj = proj;
+  cur_center_lat = center_lat;
+  if (!lut.src)
+    {
+      lut.src = malloc (WIN_WIDTH * WIN_HEIGHT * sizeof (int32_t));
+      lut.vx = malloc (WIN_WIDTH * WIN_HEIGHT * sizeof (float));
+      lut.vy = malloc (WIN_WIDTH * WIN_HEIGHT * sizeof (float));
+      lut.vz = malloc (WIN_WIDTH * WIN_HEIGHT * sizeof (float));
+      if (!lut.src || !lut.vx || !lut.vy || !lut.vz)
+	abort ();
+    }
+
+  for (j = 0, n = 0; j < WIN_HEIGHT; j++)
+    for (i = 0; i < WIN_WIDTH; i++, n++)
+      {
+	double lat, lon, slat, clat, slon, clon;
+	int x, y;
+
+	if (!inverse (proj, center_lat, i, j, &lat, &lon))
+	  {
+	    lut.src[n] = -1;
+	    lut.vx[n] = lut.vy[n] = lut.vz[n] = 0.0;
+	    continue;
+	  }
+
+	x = project_long (lon) % WIN_WIDTH;
+	y = project_lat (lat);
+	if (y >= WIN_HEIGHT)
+	  y = WIN_HEIGHT - 1;
+	lut.src[n] = 2 * y * WIN_WIDTH + x;
+
+	sincosd (lat, &slat, &clat);
+	sincosd (lon, &slon, &clon);
+	lut.vx[n] = clat * clon;
+	lut.vy[n] = clat * slon;
+	lut.vz[n] = slat;
+      }
+}
+
+
+/* Like degtrig.c, use GCC's generic vectors for the arithmetic.  AVX2
+   also has an instruction to load pixels from the map in parallel.  */
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#define VLEN 8
+#else
+#define VLEN 4
+#endif
+
+typedef int32_t vint __attribute__ ((vector_size (VLEN * sizeof (int32_t))));
+typedef uint32_t vuint __attribute__ ((vector_size (VLEN * sizeof (int32_t))));
+typedef float vfloat __attribute__ ((vector_size (VLEN * sizeof (float))));
+
+#define SPLAT(x) ((vfloat) { } + (x))
+
+/* Scale the color components of pixel P by F / 256 and make it
+   opaque.  Works on both integers and vectors.  */
+#define SHADE(p, f) \
+  (((((p) & 0xFF00FF) * (f) >> 8) & 0xFF00FF) \
+   | ((((p) & 0xFF00) * (f) >> 8) & 0xFF00) | 0xFF000000)
+
+static inline vuint
+vgather (const uint32_t *base, vint idx, vint mask)
+{
+#ifdef __AVX2__
+  return (vuint) _mm256_mask_i32gather_epi32 (_mm256_setzero_si256 (),
+					      (const int *) base,
+					      (__m256i) idx, (__m256i) mask,
+					      4);
+#else
+  vuint r;
+  int i;
+  for (i = 0; i < VLEN; i++)
+    r[i] = mask[i] ? base[idx[i]] : 0;
+  return r;
+#endif
+}
+
+static inline vfloat
+vload (const float *p)
+{
+  vfloat v;
+  memcpy (&v, p, sizeof (v));
+  return v;
+}
+
+void
+reproject_render (uint32_t *dst, int stride, double center_lon,
+		  double sun_lat, double sun_lon)
+{
+  const uint32_t *base;
+  double slat, clat, sh, ch;
+  float sx, sy, sz, ts, tc;
+  int off, i, j, n;
+
+  /* Round the rotation to a whole number of pixels of the map.  */
+  off = (int) floor (center_lon * WIN_WIDTH / 360.0) % WIN_WIDTH;
+  if (off < 0)
+    off += WIN_WIDTH;
+  base = texture + off;
+  center_lon = off * 360.0 / WIN_WIDTH;
+
+  /* Vector pointing to the subsolar point, relative to the
+     central meridian.  */
+  sincosd (sun_lat, &slat, &clat);
+  sincosd (sun_lon - center_lon, &sh, &ch);
+  sx = clat * ch;
+  sy = clat * sh;
+  sz = slat;
+  ts = sind (SUN_ALT);
+  tc = sind (CIVIL_ALT);
+
+  for (j = 0, n = 0; j < WIN_HEIGHT; j++)
+    {
+      uint32_t *row = (uint32_t *) ((char *) dst + j * stride);
+
+      for (i = 0; i + VLEN <= WIN_WIDTH; i += VLEN, n += VLEN)
+	{
+	  vint src, f;
+	  vuint p;
+	  vfloat alt;
+
+	  memcpy (&src, lut.src + n, sizeof (src));
+	  p = vgather (base, src, src >= 0);
+
+	  alt = (vload (lut.vx + n) * sx + vload (lut.vy + n) * sy
+		 + vload (lut.vz + n) * sz);
+	  f = 256 + ((alt < SPLAT (ts)) & (SUN_SHADE - 256))
+	    + ((alt < SPLAT (tc)) & (CIVIL_SHADE - SUN_SHADE));
+	  p = SHADE (p, (vuint) f);
+	  memcpy (row + i, &p, sizeof (p));
+	}
+
+      for (; i < WIN_WIDTH; i++, n++)
+	{
+	  uint32_t p = lut.src[n] >= 0 ? base[lut.src[n]] : 0;
+	  float alt = lut.vx[n] * sx + lut.vy[n] * sy + lut.vz[n] * sz;
+	  int f = alt < tc ? CIVIL_SHADE : alt < ts ? SUN_SHADE : 256;
+	  row[i] = SHADE (p, f);
+	}
+    }
+}
@@ -0,0 +1,36 @@
+/* Map reprojection interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef REPROJECT_H
+#define REPROJECT_H
+
+#include <stdint.h>
+
+enum projection
+{
+  PROJ_ORTHOGRAPHIC,		/* Globe as seen from far away */
+  PROJ_ROBINSON,
+  PROJ_POLAR_NORTH,		/* Azimuthal equidistant, centered on a pole */
+  PROJ_POLAR_SOUTH,
+  N_PROJECTIONS
+};
+
+/* Set the map to be reprojected.  It has the size of the window and
+   uses the same equirectangular projection as project.h.  */
+extern void reproject_init (const uint32_t *map, int stride);
+
+/* Select projection PROJ.  For PROJ_ORTHOGRAPHIC, CENTER_LAT is the
+   latitude at the center of the globe; the other projections ignore it.
+   The lookup tables are rebuilt only if the view changes.  */
+extern void reproject_set_view (enum projection proj, double center_lat);
+
+/* Draw the map in the current view on DST, whose rows are STRIDE bytes
+   apart, with CENTER_LON at the center, and darken the night side
+   given the subsolar point SUN_LAT, SUN_LON.  */
+extern void reproject_render (uint32_t *dst, int stride, double center_lon,
+			      double sun_lat, double sun_lon);
+
+#endif /* REPROJECT_H */
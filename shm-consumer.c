@@ -0,0 +1,190 @@
+/* Reference reader for earthview's shared memory frames.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "framering.h"
+
+/* Wait for frames published by earthview -S, read the part of each one
+   that changed where it lies in the shared memory, and report how long
+   it took from the moment the frame was finished until it was read.  */
+
+static uint64_t
+now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+compare_u64 (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+static const struct frame_ring *
+map_ring (const char *name)
+{
+  struct frame_ring header;
+  void *p;
+  int fd = shm_open (name, O_RDONLY, 0);
+
+  if (fd < 0)
+    return NULL;
+
+  if (read (fd, &header, sizeof (header)) != sizeof (header)
+      || memcmp (header.magic, FRAME_RING_MAGIC, 8) != 0)
+    {
+      close (fd);
+      errno = EINVAL;
+      return NULL;
+    }
+
+  p = mmap (NULL, header.size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  return p == MAP_FAILED ? NULL : p;
+}
+
+/* Wait until the ring's sequence number is not SEQ anymore, for at most
+   a second.  Return 0 on timeout.  */
+static int
+wait_frame (const struct frame_ring *ring, uint64_t seq)
+{
+  struct timespec timeout = { 1, 0 };
+  uint64_t start = now_ns ();
+
+  while (__atomic_load_n (&ring->seq, __ATOMIC_ACQUIRE) == seq)
+    {
+      if (now_ns () - start > 1000000000ULL)
+	return 0;
+      syscall (SYS_futex, &ring->futex, FUTEX_WAIT, (uint32_t) seq,
+	       &timeout, NULL, 0);
+    }
+
+  return 1;
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr, "Usage: shm-consumer [-n FRAMES] NAME\n");
+  fprintf (stderr, "Read FRAMES frames (default 1000) from earthview -S NAME and report\n");
+  fprintf (stderr, "the latency from the end of each frame to the end of reading it.\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  const struct frame_ring *ring;
+  uint64_t *latency, last, checksum = 0;
+  long n_frames = 1000, n = 0, dropped = 0, torn = 0;
+  double dirty = 0.0;
+  int c;
+
+  while ((c = getopt (argc, argv, "n:")) != -1)
+    switch (c)
+      {
+      case 'n':
+	n_frames = atol (optarg);
+	if (n_frames <= 0)
+	  usage ();
+	break;
+      default:
+	usage ();
+      }
+
+  if (argc - optind != 1)
+    usage ();
+
+  ring = map_ring (argv[optind]);
+  if (!ring)
+    {
+      perror (argv[optind]);
+      exit (1);
+    }
+
+  latency = malloc (n_frames * sizeof (uint64_t));
+  if (!latency)
+    abort ();
+
+  last = __atomic_load_n (&ring->seq, __ATOMIC_ACQUIRE);
+  while (n < n_frames && wait_frame (ring, last))
+    {
+      uint64_t seq = __atomic_load_n (&ring->seq, __ATOMIC_ACQUIRE);
+      const struct frame_slot *slot = &ring->slots[seq % ring->n_slots];
+      const char *pixels = (const char *) ring + slot->offset;
+      uint64_t s1, s2, timestamp;
+      uint32_t x, y, x0, y0, width, height;
+
+      dropped += seq - last - 1;
+      last = seq;
+
+      s1 = __atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE);
+      if (s1 != seq)
+	{
+	  torn++;
+	  continue;
+	}
+
+      /* The slot's fields can change under our feet too, so copy them
+	 before checking the sequence number again.  */
+      timestamp = slot->timestamp;
+      x0 = slot->dirty_x;
+      y0 = slot->dirty_y;
+      width = slot->dirty_width;
+      height = slot->dirty_height;
+      if (x0 > ring->width || width > ring->width - x0
+	  || y0 > ring->height || height > ring->height - y0)
+	width = height = 0;
+
+      for (y = y0; y < y0 + height; y++)
+	{
+	  const uint32_t *row = (const uint32_t *) (pixels + y * ring->stride);
+	  for (x = x0; x < x0 + width; x++)
+	    checksum += row[x];
+	}
+
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+      s2 = __atomic_load_n (&slot->seq, __ATOMIC_RELAXED);
+      if (s2 != s1)
+	{
+	  torn++;
+	  continue;
+	}
+
+      latency[n++] = now_ns () - timestamp;
+      dirty += (double) width * height / ((double) ring->width * ring->height);
+    }
+
+  if (n == 0)
+    {
+      fprintf (stderr, "shm-consumer: no frames received\n");
+      exit (1);
+    }
+
+  qsort (latency, n, sizeof (uint64_t), compare_u64);
+  printf ("%ld frames, %ld dropped, %ld torn, %.1f%% changed on average\n",
+	  n, dropped, torn, 100.0 * dirty / n);
+  printf ("latency (us): min %.1f median %.1f 99%% %.1f max %.1f\n",
+	  latency[0] / 1e3, latency[n / 2] / 1e3, latency[n * 99 / 100] / 1e3,
+	  latency[n - 1] / 1e3);
+  printf ("checksum %016llx\n", (unsigned long long) checksum);
+  return 0;
+}
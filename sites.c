@@ -0,0 +1,357 @@
+/* Sites overlay module.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+
+#include "drawing.h"
+#include "sunrise.h"
+#include "project.h"
+#include "anim.h"
+#include "map.h"
+#include "sites.h"
+
+/* Sites are kept in buckets, each covering a few columns of the map and
+   a band of latitudes.  All sites in a column of buckets share the
+   result of calc_sun_day: the time when the Sun is at south only needs
+   to be corrected for the small difference in longitude, and the rest
+   changes so little within a few degrees that the times stay within
+   a minute of what sun_rise_set computes.
+
+   Each bucket remembers the first time at which one of its sites will
+   see a sunrise, sunset, dawn or dusk.  Until then, none of its sites
+   changes state, so on each frame only the buckets that the terminator
+   is crossing are updated.  */
+
+#define COLUMN_PIXELS	4
+#define N_COLUMNS	(WIN_WIDTH / COLUMN_PIXELS)
+#define BAND_DEGREES	10
+#define N_BANDS		(180 / BAND_DEGREES)
+#define N_BUCKETS	(N_COLUMNS * N_BANDS)
+
+enum state
+{
+  NIGHT, CIVIL, DAY, N_STATES
+};
+
+struct site
+{
+  double lon, lat;
+  char *name;
+  int x, y;
+  int bucket;
+
+  /* Sunrise, sunset, dawn and dusk in hours UT, for the day in
+     BUCKET_DAY, and the return values of sun_day_rise_set.  */
+  double rise, set, dawn, dusk;
+  signed char rc_sun, rc_civil;
+
+  /* The state at the last update, and the next sunrise or sunset in
+     hours from the beginning of the same day, or HUGE_VAL.  */
+  unsigned char state;
+  unsigned char rising;
+  double next_sun;
+};
+
+static struct site *sites;
+static int n_sites;
+
+/* The sites in bucket B are SITES[BUCKET_FIRST[B]] up to
+   SITES[BUCKET_FIRST[B + 1] - 1].  BUCKET_NEXT is the time of the next
+   update, in hours since 2000 Jan 0.0.  */
+static int bucket_first[N_BUCKETS + 1];
+static double bucket_next[N_BUCKETS];
+static int bucket_day[N_BUCKETS];
+
+static struct sun_day column_day[N_COLUMNS];
+static int cur_day = INT_MIN;
+static double last_now;
+
+static int show_labels = 1;
+
+static const double state_color[N_STATES][3] = {
+  { 0.4, 0.6, 1.0 },		/* NIGHT */
+  { 1.0, 0.5, 0.0 },		/* CIVIL */
+  { 1.0, 0.9, 0.0 }		/* DAY */
+};
+
+static double
+column_lon (int c)
+{
+  return (c + 0.5) * COLUMN_PIXELS * 360.0 / WIN_WIDTH - 180.0;
+}
+
+static int
+compare_bucket (const void *a, const void *b)
+{
+  const struct site *sa = a, *sb = b;
+  return sa->bucket - sb->bucket;
+}
+
+int
+init_sites (const char *file)
+{
+  FILE *f = fopen (file, "r");
+  char line[256];
+  int max_sites = 0, band, b, i;
+
+  if (!f)
+    return -1;
+
+  while (fgets (line, sizeof (line), f))
+    {
+      char *p = line, *end;
+      struct site *s;
+      size_t len;
+
+      while (*p == ' ' || *p == '\t')
+	p++;
+      if (*p == '#' || *p == '\n' || *p == '\0')
+	continue;
+
+      if (n_sites == max_sites)
+	{
+	  max_sites = max_sites ? max_sites * 2 : 256;
+	  sites = realloc (sites, max_sites * sizeof (struct site));
+	  if (!sites)
+	    abort ();
+	}
+
+      s = &sites[n_sites];
+      memset (s, 0, sizeof (struct site));
+      s->lon = strtod (p, &end);
+      if (end == p)
+	goto bad;
+      p = end;
+      while (*p == ' ' || *p == '\t' || *p == ',')
+	p++;
+      s->lat = strtod (p, &end);
+      if (end == p || s->lat < -90.0 || s->lat > 90.0)
+	goto bad;
+      p = end;
+      while (*p == ' ' || *p == '\t' || *p == ',')
+	p++;
+
+      len = strcspn (p, "\r\n");
+      if (len > 0)
+	s->name = strndup (p, len);
+
+      s->lon -= 360.0 * floor ((s->lon + 180.0) / 360.0);
+      s->x = project_long (s->lon) % WIN_WIDTH;
+      s->y = project_lat (s->lat);
+      band = (s->lat + 90.0) / BAND_DEGREES;
+      if (band == N_BANDS)
+	band--;
+      s->bucket = (s->x / COLUMN_PIXELS) * N_BANDS + band;
+      n_sites++;
+      continue;
+
+    bad:
+      fprintf (stderr, "earthview: invalid site: %s", line);
+      fclose (f);
+      errno = EINVAL;
+      return -1;
+    }
+
+  fclose (f);
+
+  /* Sort the sites by bucket, so that each bucket is a range.  */
+  qsort (sites, n_sites, sizeof (struct site), compare_bucket);
+  for (b = 0, i = 0; b <= N_BUCKETS; b++)
+    {
+      while (i < n_sites && sites[i].bucket < b)
+	i++;
+      bucket_first[b] = i;
+      if (b < N_BUCKETS)
+	bucket_day[b] = INT_MIN;
+    }
+
+  return 0;
+}
+
+
+/* Return whether the Sun is above the horizon at HM hours, like
+   has_daylight in terminator.c.  */
+static int
+is_lit (int rc, double rise, double set, double hm)
+{
+  switch (rc)
+    {
+    case -1:
+      return 0;
+    case 1:
+      return 1;
+    default:
+      return ((hm > rise && hm < set)
+	      || (hm + 24 > rise && hm + 24 < set)
+	      || (hm - 24 > rise && hm - 24 < set));
+    }
+}
+
+/* Return the first time, not earlier than HM, when the Sun rises or
+   sets, and store in *RISING which of the two happens.  */
+static double
+next_crossing (int rc, double rise, double set, double hm,
+	       unsigned char *rising)
+{
+  double best = HUGE_VAL;
+  int k;
+
+  if (rc != 0)
+    return best;
+
+  for (k = -24; k <= 24; k += 24)
+    {
+      if (rise + k >= hm && rise + k < best)
+	best = rise + k, *rising = 1;
+      if (set + k >= hm && set + k < best)
+	best = set + k, *rising = 0;
+    }
+
+  return best;
+}
+
+static void
+update_bucket (int b, double hm)
+{
+  int c = b / N_BANDS;
+  double next = 24.0, lon = column_lon (c);
+  unsigned char rising;
+  int i;
+
+  for (i = bucket_first[b]; i < bucket_first[b + 1]; i++)
+    {
+      struct site *s = &sites[i];
+      double t;
+      int sun, civil;
+
+      if (bucket_day[b] != cur_day)
+	{
+	  struct sun_day sd = column_day[c];
+	  sd.tsouth -= (s->lon - lon) / 15.0;
+	  s->rc_sun = sun_day_rise_set (&sd, s->lat, -35.0 / 60.0, 1,
+					&s->rise, &s->set);
+	  s->rc_civil = sun_day_rise_set (&sd, s->lat, -6.0, 0,
+					  &s->dawn, &s->dusk);
+	}
+
+      sun = is_lit (s->rc_sun, s->rise, s->set, hm);
+      civil = is_lit (s->rc_civil, s->dawn, s->dusk, hm);
+      s->state = sun ? DAY : civil ? CIVIL : NIGHT;
+
+      s->next_sun = next_crossing (s->rc_sun, s->rise, s->set, hm,
+				   &s->rising);
+      t = next_crossing (s->rc_civil, s->dawn, s->dusk, hm, &rising);
+      if (s->next_sun < next)
+	next = s->next_sun;
+      if (t < next)
+	next = t;
+    }
+
+  /* The times are recomputed at the beginning of every day.  */
+  bucket_day[b] = cur_day;
+  bucket_next[b] = cur_day * 24.0 + next;
+}
+
+static void
+update_sites (const struct time *t)
+{
+  int day = days_this_millennium (t->year, t->month, t->day);
+  double hm = t->h + t->m / 60.0;
+  double now = day * 24.0 + hm;
+  int b, c, all = now < last_now;
+
+  if (day != cur_day)
+    {
+      for (c = 0; c < N_COLUMNS; c++)
+	calc_sun_day (t->year, t->month, t->day, column_lon (c),
+		      &column_day[c]);
+      cur_day = day;
+      all = 1;
+    }
+
+  /* If the day changed or the time went back, every bucket needs an
+     update.  */
+  if (all)
+    for (b = 0; b < N_BUCKETS; b++)
+      bucket_next[b] = -HUGE_VAL;
+
+  last_now = now;
+  for (b = 0; b < N_BUCKETS; b++)
+    if (bucket_next[b] <= now)
+      update_bucket (b, hm);
+}
+
+/* Draw all the markers of the same color, and then all the labels,
+   as a single path.  */
+static void
+draw_sites (cairo_t *cairo_context)
+{
+  char label[80];
+  int i, state;
+
+  cairo_save (cairo_context);
+  for (state = 0; state < N_STATES; state++)
+    {
+      cairo_new_path (cairo_context);
+      for (i = 0; i < n_sites; i++)
+	if (sites[i].state == state)
+	  cairo_rectangle (cairo_context, sites[i].x - 1.5, sites[i].y - 1.5,
+			   3.0, 3.0);
+
+      cairo_set_source_rgb (cairo_context, state_color[state][0],
+			    state_color[state][1], state_color[state][2]);
+      cairo_fill (cairo_context);
+    }
+
+  if (show_labels)
+    {
+      cairo_new_path (cairo_context);
+      cairo_set_font_size (cairo_context, 9.0);
+      for (i = 0; i < n_sites; i++)
+	{
+	  struct site *s = &sites[i];
+	  int m;
+
+	  if (!s->name)
+	    continue;
+
+	  if (s->next_sun == HUGE_VAL)
+	    snprintf (label, sizeof (label), "%s", s->name);
+	  else
+	    {
+	      m = (int) rint (s->next_sun * 60.0) % 1440;
+	      snprintf (label, sizeof (label), "%s %s %02d:%02d", s->name,
+			s->rising ? "rise" : "set", m / 60, m % 60);
+	    }
+
+	  cairo_move_to (cairo_context, s->x + 3.0, s->y - 3.0);
+	  cairo_text_path (cairo_context, label);
+	}
+
+      cairo_set_source_rgb (cairo_context, 1.0, 1.0, 1.0);
+      cairo_fill (cairo_context);
+    }
+
+  cairo_restore (cairo_context);
+}
+
+void
+do_sites (cairo_t *cairo_context, SDL_Event *event)
+{
+  if (event->type == SDL_KEYDOWN && event->key.keysym.sym == SDLK_l)
+    show_labels = !show_labels;
+
+  if (n_sites == 0 || !map_equirectangular ())
+    return;
+
+  update_sites (&cur_time);
+  draw_sites (cairo_context);
+}
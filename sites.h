@@ -0,0 +1,21 @@
+/* Sites overlay interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef SITES_H
+#define SITES_H
+
+#include <cairo.h>
+#include <SDL.h>
+
+/* Load the sites from FILE.  Each line has a longitude and a latitude
+   in degrees, like the locations for sunrise-table, optionally followed
+   by a name.  Return 0 on success, -1 with errno set on failure.  */
+extern int init_sites (const char *file);
+
+/* Draw the sites on every iteration.  */
+extern void do_sites (cairo_t *, SDL_Event *);
+
+#endif /* SITES_H */
@@ -0,0 +1,409 @@
+/* Sunrise and sunset tables for many locations and days.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "sunrise.h"
+#include "ephem.h"
+#include "parallel.h"
+
+/* Locations are read in batches, and each batch is split in blocks that
+   are computed (and, for CSV output, formatted) in parallel, and then
+   written in order.  This way memory usage does not depend on the
+   number of locations.  Each block covers a few locations and a range of
+   days, and has at most BLOCK_ROWS rows; rows are ordered by location
+   and then by day.
+
+   The binary format starts with a header made of the 8 bytes "SUNTABLE",
+   and four 32-bit integers: the year, month and day of the first date,
+   and the number of days.  Each block then has four 32-bit integers (the
+   first location, the number of locations, the first day and the number
+   of days in the block), followed by one array of 32-bit floats for each
+   column.  Integers and floats are in the machine's byte order.  */
+
+#define BLOCK_ROWS	16384
+#define BLOCKS_PER_THREAD 4
+
+enum column
+{
+  SUNRISE, SUNSET, CIVIL_DAWN, CIVIL_DUSK, ASTRO_DAWN, ASTRO_DUSK,
+  DAY_LENGTH, N_COLUMNS
+};
+
+static const char csv_header[] =
+  "location,date,sunrise,sunset,civil_dawn,civil_dusk,"
+  "astro_dawn,astro_dusk,day_length\n";
+
+/* The longest CSV row: location, date, and seven numbers.  */
+#define MAX_ROW_LENGTH	(12 + 11 + N_COLUMNS * 12)
+
+struct location
+{
+  double lon, lat;
+};
+
+struct block
+{
+  struct location *locs;
+  long first;
+  int loc0, n_locs;
+  int day0, n_days;
+  float *cols;
+  char *text;
+  size_t text_len;
+};
+
+static int year, month, day, n_days;
+static int binary;
+static char (*dates)[11];
+
+/* Write X with three decimals at P, and return the end of the string.
+   NaNs are written as an empty string.  */
+
+static char *
+put_fixed (char *p, float x)
+{
+  char buf[16], *q = buf + sizeof (buf);
+  long n;
+  int i;
+
+  if (isnan (x))
+    return p;
+
+  if (x < 0)
+    *p++ = '-', x = -x;
+
+  n = (long) (x * 1000.0 + 0.5);
+  for (i = 0; i < 3; i++, n /= 10)
+    *--q = '0' + n % 10;
+  *--q = '.';
+  do
+    *--q = '0' + n % 10;
+  while (n /= 10);
+
+  i = buf + sizeof (buf) - q;
+  memcpy (p, q, i);
+  return p + i;
+}
+
+static char *
+put_int (char *p, long n)
+{
+  char buf[24], *q = buf + sizeof (buf);
+  int i;
+
+  do
+    *--q = '0' + n % 10;
+  while (n /= 10);
+
+  i = buf + sizeof (buf) - q;
+  memcpy (p, q, i);
+  return p + i;
+}
+
+static void
+rise_set (const struct sun_day *sd, double lat, double altit, int upper_limb,
+	  float *rise, float *set)
+{
+  double trise, tset;
+
+  switch (sun_day_rise_set (sd, lat, altit, upper_limb, &trise, &tset))
+    {
+    case 0:
+      *rise = trise;
+      *set = tset;
+      break;
+
+    default:
+      *rise = *set = NAN;
+      break;
+    }
+}
+
+static void
+compute_block (int i, void *data)
+{
+  struct block *b = (struct block *) data + i;
+  int n_rows = b->n_locs * b->n_days;
+  int l, j, row;
+
+  for (l = 0, row = 0; l < b->n_locs; l++)
+    for (j = b->day0; j < b->day0 + b->n_days; j++, row++)
+      {
+	const struct location *loc = &b->locs[b->loc0 + l];
+	float *cols = b->cols;
+	struct sun_day sd;
+	double trise, tset;
+	int rc;
+
+	/* days_this_millennium is linear in the day, so there is no need
+	   to normalize the date.  */
+	calc_sun_day (year, month, day + j, loc->lon, &sd);
+
+	rc = sun_day_rise_set (&sd, loc->lat, -35.0/60.0, 1, &trise, &tset);
+	cols[SUNRISE * n_rows + row] = (rc == 0 ? trise : NAN);
+	cols[SUNSET * n_rows + row] = (rc == 0 ? tset : NAN);
+	cols[DAY_LENGTH * n_rows + row] = tset - trise;
+
+	rise_set (&sd, loc->lat, -6.0, 0,
+		  &cols[CIVIL_DAWN * n_rows + row],
+		  &cols[CIVIL_DUSK * n_rows + row]);
+	rise_set (&sd, loc->lat, -18.0, 0,
+		  &cols[ASTRO_DAWN * n_rows + row],
+		  &cols[ASTRO_DUSK * n_rows + row]);
+      }
+
+  if (!binary)
+    {
+      char *p = b->text;
+      for (l = 0, row = 0; l < b->n_locs; l++)
+	for (j = b->day0; j < b->day0 + b->n_days; j++, row++)
+	  {
+	    int c;
+	    p = put_int (p, b->first + l);
+	    *p++ = ',';
+	    memcpy (p, dates[j], 10);
+	    p += 10;
+	    for (c = 0; c < N_COLUMNS; c++)
+	      {
+		*p++ = ',';
+		p = put_fixed (p, b->cols[c * n_rows + row]);
+	      }
+	    *p++ = '\n';
+	  }
+
+      b->text_len = p - b->text;
+    }
+}
+
+static void
+write_block (const struct block *b, FILE *out)
+{
+  int32_t hdr[4];
+
+  if (!binary)
+    {
+      fwrite (b->text, 1, b->text_len, out);
+      return;
+    }
+
+  hdr[0] = b->first;
+  hdr[1] = b->n_locs;
+  hdr[2] = b->day0;
+  hdr[3] = b->n_days;
+  fwrite (hdr, sizeof (hdr), 1, out);
+  fwrite (b->cols, sizeof (float), N_COLUMNS * b->n_locs * b->n_days, out);
+}
+
+/* Read up to N locations from F.  Each line has a longitude and a
+   latitude separated by spaces or a comma; empty lines and lines
+   starting with # are skipped.  */
+
+static int
+read_locations (FILE *f, struct location *locs, int n)
+{
+  char line[256];
+  int i = 0;
+
+  while (i < n && fgets (line, sizeof (line), f))
+    {
+      char *p = line, *end;
+
+      while (*p == ' ' || *p == '\t')
+	p++;
+      if (*p == '#' || *p == '\n' || *p == '\0')
+	continue;
+
+      locs[i].lon = strtod (p, &end);
+      if (end == p)
+	goto bad;
+      p = end;
+      while (*p == ' ' || *p == '\t' || *p == ',')
+	p++;
+      locs[i].lat = strtod (p, &end);
+      if (end == p)
+	goto bad;
+      i++;
+      continue;
+
+    bad:
+      fprintf (stderr, "sunrise-table: invalid location: %s", line);
+      exit (1);
+    }
+
+  return i;
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr, "Usage: sunrise-table [-be] [-o OUTPUT] YYYY-MM-DD YYYY-MM-DD [LOCATIONS]\n");
+  fprintf (stderr, "Compute tables of sunrise, sunset and twilight times in hours UT,\n");
+  fprintf (stderr, "and day lengths in hours, for every location and day in the range.\n");
+  fprintf (stderr, "  -b  write binary columnar output instead of CSV\n");
+  fprintf (stderr, "  -e  compute the Sun's position from tables (see ephem-test)\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  FILE *in = stdin, *out = stdout;
+  struct block *blocks;
+  struct location *locs;
+  int end_year, end_month, end_day;
+  int locs_per_block, days_per_block, max_blocks, max_locs;
+  long first_loc;
+  int use_tables = 0;
+  int i, c;
+
+  while ((c = getopt (argc, argv, "beo:")) != -1)
+    switch (c)
+      {
+      case 'b':
+	binary = 1;
+	break;
+      case 'e':
+	use_tables = 1;
+	break;
+      case 'o':
+	out = fopen (optarg, "wb");
+	if (!out)
+	  {
+	    perror (optarg);
+	    exit (1);
+	  }
+	break;
+      default:
+	usage ();
+      }
+
+  if (argc - optind < 2 || argc - optind > 3
+      || sscanf (argv[optind], "%d-%d-%d", &year, &month, &day) != 3
+      || sscanf (argv[optind + 1], "%d-%d-%d",
+		 &end_year, &end_month, &end_day) != 3)
+    usage ();
+
+  n_days = days_from_civil (end_year, end_month, end_day)
+    - days_from_civil (year, month, day) + 1;
+  if (n_days <= 0)
+    usage ();
+
+  if (argc - optind == 3)
+    {
+      in = fopen (argv[optind + 2], "r");
+      if (!in)
+	{
+	  perror (argv[optind + 2]);
+	  exit (1);
+	}
+    }
+
+  if (use_tables && ephem_init (year, end_year) != 0)
+    {
+      fprintf (stderr, "sunrise-table: cannot build ephemeris tables\n");
+      exit (1);
+    }
+
+  dates = malloc (n_days * sizeof (*dates));
+  for (i = 0; i < n_days; i++)
+    {
+      int y, m, d;
+      civil_from_days (days_from_civil (year, month, day) + i, &y, &m, &d);
+      sprintf (dates[i], "%04d-%02d-%02d", y, m, d);
+    }
+
+  /* Either a block has a single location and part of the days, or it
+     has all the days for one or more locations.  */
+  if (n_days >= BLOCK_ROWS)
+    locs_per_block = 1, days_per_block = BLOCK_ROWS;
+  else
+    locs_per_block = BLOCK_ROWS / n_days, days_per_block = n_days;
+
+  max_blocks = parallel_threads () * BLOCKS_PER_THREAD;
+  max_locs = (n_days >= BLOCK_ROWS ? 1 : max_blocks * locs_per_block);
+  locs = malloc (max_locs * sizeof (struct location));
+  blocks = calloc (max_blocks, sizeof (struct block));
+  if (!locs || !blocks || !dates)
+    abort ();
+
+  for (i = 0; i < max_blocks; i++)
+    {
+      blocks[i].locs = locs;
+      blocks[i].cols = malloc (N_COLUMNS * BLOCK_ROWS * sizeof (float));
+      if (!binary)
+	blocks[i].text = malloc (BLOCK_ROWS * MAX_ROW_LENGTH);
+      if (!blocks[i].cols || (!binary && !blocks[i].text))
+	abort ();
+    }
+
+  if (binary)
+    {
+      int32_t hdr[4] = { year, month, day, n_days };
+      fwrite ("SUNTABLE", 8, 1, out);
+      fwrite (hdr, sizeof (hdr), 1, out);
+    }
+  else
+    fputs (csv_header, out);
+
+  first_loc = 0;
+  for (;;)
+    {
+      int n_locs = read_locations (in, locs, max_locs);
+      int n_blocks = 0;
+      int day0 = 0, loc0 = 0;
+
+      if (n_locs == 0)
+	break;
+
+      /* With a single location per batch, the batch covers as many
+	 days as the blocks can hold, and the next one continues
+	 from there.  */
+      do
+	{
+	  struct block *b = &blocks[n_blocks++];
+	  b->first = first_loc + loc0;
+	  b->loc0 = loc0;
+	  b->n_locs = n_locs - loc0 < locs_per_block ? n_locs - loc0
+	    : locs_per_block;
+	  b->day0 = day0;
+	  b->n_days = n_days - day0 < days_per_block ? n_days - day0
+	    : days_per_block;
+
+	  day0 += b->n_days;
+	  if (day0 == n_days)
+	    {
+	      day0 = 0;
+	      loc0 += b->n_locs;
+	    }
+
+	  if (n_blocks == max_blocks || loc0 == n_locs)
+	    {
+	      parallel_for (n_blocks, compute_block, blocks);
+	      for (i = 0; i < n_blocks; i++)
+		write_block (&blocks[i], out);
+	      n_blocks = 0;
+	    }
+	}
+      while (loc0 < n_locs);
+
+      first_loc += n_locs;
+    }
+
+  if (fflush (out) != 0 || ferror (out))
+    {
+      perror ("sunrise-table");
+      exit (1);
+    }
+
+  return 0;
+}
@@ -7,19 +7,9 @@
 #include <stdio.h>
 #include <math.h>
 
-/* Trigonometric functions in degrees.  */
-
-#define DEG_RAD         (M_PI / 180.0)
-#define RAD_DEG         (180.0 / M_PI)
-
-#define sind(x)         sin((x) * DEG_RAD)
-#define cosd(x)         cos((x) * DEG_RAD)
-#define tand(x)         tan((x) * DEG_RAD)
-
-#define atand(x)        (RAD_DEG * atan(x))
-#define asind(x)        (RAD_DEG * asin(x))
-#define acosd(x)        (RAD_DEG * acos(x))
-#define atan2d(y,x)     (RAD_DEG * atan2(y,x))
+#include "sunrise.h"
+#include "ephem.h"
+#include "degtrig.h"
 
 
 /* This function reduces any angle to within the first revolution by subtracting
@@ -42,13 +32,12 @@ normalize180 (double x)
 static void
 calc_sun_position (double d, double *sin_slon, double *cos_slon, double *r)
 {
-  double M,			/* Mean anomaly of the Sun */
+  double M, sM, cM,		/* Mean anomaly of the Sun + sin/cos */
     w, sw, cw,			/* Mean longitude of perihelion + sin/cos */
     /* Note: Sun's mean longitude = M + w */
     e,				/* Eccentricity of Earth's orbit */
-    E,				/* Eccentric anomaly */
+    E, sE, cE,			/* Eccentric anomaly + sin/cos */
     x, y,			/* x, y coordinates in orbit */
-    v,				/* True anomaly */
     rinv;
 
   /* Compute mean elements */
@@ -57,16 +46,17 @@ calc_sun_position (double d, double *sin_slon, double *cos_slon, double *r)
   e = 0.016709 - 1.151E-9 * d;
 
   /* Compute true longitude and radius vector */
-  E = M + e * RAD_DEG * sind (M) * (1.0 + e * cosd (M));
-  x = cosd (E) - e;
-  y = sqrt (1.0 - e * e) * sind (E);
+  sincosd (M, &sM, &cM);
+  E = M + e * RAD_DEG * sM * (1.0 + e * cM);
+  sincosd (E, &sE, &cE);
+  x = cE - e;
+  y = sqrt (1.0 - e * e) * sE;
   *r = sqrt (x * x + y * y);	/* Solar distance */
 
   /* compute sin (v + w) and cos (v + w), where sin(v) = y/r and cos(v) = x/r,
      using addition formulas.  */
   rinv = 1.0 / *r;
-  sw = sind (w);
-  cw = cosd (w);
+  sincosd (w, &sw, &cw);
   *sin_slon = (x * sw + y * cw) * rinv;
   if (cos_slon)
     *cos_slon = (x * cw - y * sw) * rinv;
@@ -75,7 +65,7 @@ calc_sun_position (double d, double *sin_slon, double *cos_slon, double *r)
 static void
 calc_sun_ra_and_decl (double d, double *RA, double *sdec, double *cdec, double *r)
 {
-  double lon, obl_ecl, x, y, z;
+  double obl_ecl, so, co, x, y, z;
 
   /* Compute Sun's ecliptical coordinates */
   calc_sun_position (d, &y, &x, r);
@@ -84,8 +74,9 @@ calc_sun_ra_and_decl (double d, double *RA, double *sdec, double *cdec, double *
   obl_ecl = 23.4393 - 3.563E-7 * d;
 
   /* Convert to equatorial rectangular coordinates - x is uchanged */
-  z = y * sind (obl_ecl);
-  y = y * cosd (obl_ecl);
+  sincosd (obl_ecl, &so, &co);
+  z = y * so;
+  y = y * co;
 
   /* Convert to spherical coordinates */
   *RA = atan2d (y, x);
@@ -93,11 +84,38 @@ calc_sun_ra_and_decl (double d, double *RA, double *sdec, double *cdec, double *
   *cdec = sqrt (1.0 - z * z);
 }
 
-/* This function computes the number of days elapsed since 1/1/2000.  */
-static inline int
-days_this_millennium (int y, int m, int d)
+/* This function computes the Sun's position at D days since 2000 Jan 0.0
+   with the formulas above.  */
+void
+calc_sun_ephemeris_exact (double d, struct sun_ephemeris *se)
+{
+  calc_sun_ra_and_decl (d, &se->ra, &se->sdec, &se->cdec, &se->r);
+  se->eqtime = normalize180 (sun_mean_longitude (d) - se->ra);
+}
+
+/* Likewise, but use the tables built by ephem_init if they cover D.  */
+void
+calc_sun_ephemeris (double d, struct sun_ephemeris *se)
 {
-  return 367L * y - 7 * (y + (m + 9) / 12) / 4 + 275 * m / 9 + d - 730530L;
+  if (!ephem_lookup (d, se))
+    calc_sun_ephemeris_exact (d, se);
+}
+
+
+/* This function computes the point where the Sun is at the zenith at
+   HOURS UT of the given day.  At that moment it is noon there, which
+   happens when the hour angle of the Sun's mean position, corrected
+   by the equation of time, is zero.  */
+void
+calc_subsolar_point (int year, int month, int day, double hours,
+		     double *lat, double *lon)
+{
+  struct sun_ephemeris se;
+
+  calc_sun_ephemeris (days_this_millennium (year, month, day) + hours / 24.0,
+		      &se);
+  *lat = atan2d (se.sdec, se.cdec);
+  *lon = normalize180 (180.0 - 15.0 * hours - se.eqtime);
 }
 
 
@@ -114,23 +132,15 @@ GMST0 (double d)
 }
 
 
-int calc_sun_rise_set
-  (int year,
-   int month,
-   int day,
-   double lon,
-   double lat, double altit, int upper_limb, double *trise, double *tset)
+/* This function computes the quantities that sunrise and sunset times
+   at longitude LON on the given day depend on, but that do not depend
+   on the latitude.  */
+void
+calc_sun_day (int year, int month, int day, double lon, struct sun_day *sd)
 {
   double d,			/* Days since 2000 Jan 0.0 (negative before) */
-    sr,				/* Solar distance, astronomical units */
-    sRA,			/* Sun's Right Ascension */
-    sdec, cdec,			/* Sun's declination sine and cosine */
-    t,				/* Diurnal arc */
-    tsouth,			/* Time when Sun is at south */
-    sidtime,			/* Local sidereal time */
-    cost;
-
-  int rc = 0;			/* Return code from function - usually 0 */
+    sidtime;			/* Local sidereal time */
+  struct sun_ephemeris se;	/* Sun's position */
 
   /* Compute d of 12h local mean solar time */
   d = days_this_millennium (year, month, day) + 0.5 - lon / 360.0;
@@ -139,19 +149,34 @@ int calc_sun_rise_set
   sidtime = normalize (GMST0 (d) + 180.0 + lon);
 
   /* Compute Sun's RA + Decl at this moment */
-  calc_sun_ra_and_decl (d, &sRA, &sdec, &cdec, &sr);
+  calc_sun_ephemeris (d, &se);
+  sd->sdec = se.sdec;
+  sd->cdec = se.cdec;
+  sd->sr = se.r;
 
   /* Compute time when Sun is at south - in hours UT */
-  tsouth = 12.0 - normalize180 (sidtime - sRA) / 15.0;
+  sd->tsouth = 12.0 - normalize180 (sidtime - se.ra) / 15.0;
+}
+
+int
+sun_day_rise_set (const struct sun_day *sd, double lat, double altit,
+		  int upper_limb, double *trise, double *tset)
+{
+  double t,			/* Diurnal arc */
+    slat, clat,			/* Sine and cosine of the latitude */
+    cost;
+
+  int rc = 0;			/* Return code from function - usually 0 */
 
   /* Compute the Sun's apparent radius to do correction to upper limb,
      if necessary */
   if (upper_limb)
-    altit -= 0.2666 / sr;
+    altit -= 0.2666 / sd->sr;
 
   /* Compute the diurnal arc that the Sun traverses to reach */
   /* the specified altitide altit: */
-  cost = (sind (altit) - sind (lat) * sdec) / (cosd (lat) * cdec);
+  sincosd (lat, &slat, &clat);
+  cost = (sind (altit) - slat * sd->sdec) / (clat * sd->cdec);
   if (cost >= 1.0)
     {
       rc = -1;
@@ -168,45 +193,50 @@ int calc_sun_rise_set
     }
 
   /* Store rise and set times - in hours UTC */
-  *trise = tsouth - t;
-  *tset = tsouth + t;
+  *trise = sd->tsouth - t;
+  *tset = sd->tsouth + t;
 
   return rc;
 }
 
+int calc_sun_rise_set
+  (int year,
+   int month,
+   int day,
+   double lon,
+   double lat, double altit, int upper_limb, double *trise, double *tset)
+{
+  struct sun_day sd;
+
+  calc_sun_day (year, month, day, lon, &sd);
+  return sun_day_rise_set (&sd, lat, altit, upper_limb, trise, tset);
+}
+
 double calc_day_length
   (int year,
    int month, int day, double lon, double lat, double altit, int upper_limb)
 {
   double d,			/* Days since 2000 Jan 0.0 (negative before) */
-    obl_ecl,			/* Obliquity (inclination) of Earth's axis */
-    sr,				/* Solar distance, astronomical units */
-    sin_slon,			/* Sine of True solar longitude */
-    sin_sdecl,			/* Sine of Sun's declination */
-    cos_sdecl,			/* Cosine of Sun's declination */
     t,				/* Diurnal arc */
+    slat, clat,			/* Sine and cosine of the latitude */
     cost;
+  struct sun_ephemeris se;	/* Sun's position */
 
   d = days_this_millennium (year, month, day) + 0.5 - lon / 360.0;
 
-  /* Compute obliquity of ecliptic (inclination of Earth's axis) */
-  obl_ecl = 23.4393 - 3.563E-7 * d;
-
-  /* Compute Sun's position */
-  calc_sun_position (d, &sin_slon, NULL, &sr);
-
-  /* Compute sine and cosine of Sun's declination */
-  sin_sdecl = sind (obl_ecl) * sin_slon;
-  cos_sdecl = sqrt (1.0 - sin_sdecl * sin_sdecl);
+  /* Compute Sun's position, including the sine and cosine of its
+     declination */
+  calc_sun_ephemeris (d, &se);
 
   /* Compute the Sun's apparent radius to do correction to upper limb,
      if necessary */
   if (upper_limb)
-    altit -= 0.2666 / sr;
+    altit -= 0.2666 / se.r;
 
   /* Compute the diurnal arc that the Sun traverses to reach */
   /* the specified altitide altit: */
-  cost = (sind (altit) - sind (lat) * sin_sdecl) / (cosd (lat) * cos_sdecl);
+  sincosd (lat, &slat, &clat);
+  cost = (sind (altit) - slat * se.sdec) / (clat * se.cdec);
   if (cost >= 1.0)
     t = 0.0;			/* Sun always below altit.  */
   else if (cost <= -1.0)
@@ -216,3 +246,32 @@ double calc_day_length
 
   return t;
 }
+
+/* Days from civil dates and back, after H. Hinnant's algorithms.  Day 0
+   is March 1st of year 0, and the years before are negative.  */
+long
+days_from_civil (int y, int m, int d)
+{
+  long era;
+  int yoe, doy;
+
+  y -= m <= 2;
+  era = (y >= 0 ? y : y - 399) / 400;
+  yoe = y - era * 400;
+  doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy;
+}
+
+void
+civil_from_days (long z, int *y, int *m, int *d)
+{
+  long era = (z >= 0 ? z : z - 146096) / 146097;
+  int doe = z - era * 146097;
+  int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int mp = (5 * doy + 2) / 153;
+
+  *d = doy - (153 * mp + 2) / 5 + 1;
+  *m = mp + (mp < 10 ? 3 : -9);
+  *y = yoe + era * 400 + (*m <= 2);
+}
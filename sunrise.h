@@ -14,6 +14,64 @@ extern double calc_day_length (int, int, int, double, double, double, int);
 extern int calc_sun_rise_set (int, int, int, double, double, double, int,
 			      double *, double *);
 
+/* Sunrise and sunset times at all latitudes along a meridian depend on
+   a few quantities that can be computed once per day and longitude
+   with calc_sun_day, and then passed to sun_day_rise_set.  The result
+   is the same as calc_sun_rise_set's.  */
+
+struct sun_day
+{
+  double tsouth;		/* Time when the Sun is at south, hours UT */
+  double sdec, cdec;		/* Sine and cosine of the Sun's declination */
+  double sr;			/* Solar distance, astronomical units */
+};
+
+extern void calc_sun_day (int, int, int, double, struct sun_day *);
+extern int sun_day_rise_set (const struct sun_day *, double, double, int,
+			     double *, double *);
+
+/* Position of the Sun at a given instant, expressed as a number of days
+   since 2000 Jan 0.0.  calc_sun_ephemeris uses the tables built by
+   ephem_init (see ephem.h) when they are available, while
+   calc_sun_ephemeris_exact always uses the formulas.  */
+
+struct sun_ephemeris
+{
+  double ra;			/* Right ascension, degrees */
+  double sdec, cdec;		/* Sine and cosine of declination */
+  double eqtime;		/* Equation of time (mean longitude minus
+				   right ascension), degrees */
+  double r;			/* Solar distance, astronomical units */
+};
+
+extern void calc_sun_ephemeris (double, struct sun_ephemeris *);
+extern void calc_sun_ephemeris_exact (double, struct sun_ephemeris *);
+
+/* This function computes the number of days elapsed since 1/1/2000.  */
+static inline int
+days_this_millennium (int y, int m, int d)
+{
+  return 367L * y - 7 * (y + (m + 9) / 12) / 4 + 275 * m / 9 + d - 730530L;
+}
+
+/* Convert a date of the Gregorian calendar to a number of days and
+   back.  Unlike days_this_millennium, these are exact for any date, so
+   they can be used to count and step through days; the epoch is not
+   2000.  */
+extern long days_from_civil (int y, int m, int d);
+extern void civil_from_days (long days, int *y, int *m, int *d);
+
+/* Compute the latitude and longitude where the Sun is at the zenith
+   at the given day and time, in hours UT.  */
+extern void calc_subsolar_point (int, int, int, double, double *, double *);
+
+/* The Sun's mean longitude, in degrees.  */
+static inline double
+sun_mean_longitude (double d)
+{
+  return (-3.9530 + 282.9404) + (0.9856002585 + 4.70935E-5) * d;
+}
+
 /* This function returns whether it is spring or summer in the northern
    (if return value is 1) or southern (if return value is 0) hemisphere
    at the given time.  */
@@ -85,6 +143,17 @@ civil_rise_set (int year, int month, int day, double lon, double lat,
 			    rise, set);
 }
 
+/* This function computes the start and end times of nautical twilight.
+   Nautical twilight starts/ends when the Sun's center is 12 degrees
+   below the horizon.  */
+static inline int
+nautical_rise_set (int year, int month, int day, double lon, double lat,
+		   double *rise, double *set)
+{
+  return calc_sun_rise_set (year, month, day, lon, lat, -12.0, 0,
+			    rise, set);
+}
+
 /* This function computes the start and end times of astronomical twilight.
    Astronomical twilight starts/ends when the Sun's center is 18 degrees
    below the horizon.  */
@@ -0,0 +1,139 @@
+/* Export of day/night boundaries as geometry.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "ephem.h"
+#include "export.h"
+
+static void
+usage (void)
+{
+  fprintf (stderr, "Usage: terminator-export [-be] [-l LEVELS] [-n COUNT] [-s MINUTES] [-r DEGREES]\n");
+  fprintf (stderr, "                         [-o OUTPUT] YYYY-MM-DD[THH:MM]\n");
+  fprintf (stderr, "Write the regions where the Sun is up at COUNT instants, MINUTES apart,\n");
+  fprintf (stderr, "starting at the given time UT.\n");
+  fprintf (stderr, "  -b  write binary polylines instead of GeoJSON\n");
+  fprintf (stderr, "  -e  compute the Sun's position from tables (see ephem-test)\n");
+  fprintf (stderr, "  -l  comma-separated list of sunrise, civil, nautical and astronomical\n");
+  fprintf (stderr, "      (default: all)\n");
+  fprintf (stderr, "  -r  degrees between grid points (default: 1)\n");
+  exit (1);
+}
+
+static unsigned
+parse_levels (char *arg)
+{
+  unsigned levels = 0;
+  char *p;
+
+  for (p = strtok (arg, ","); p; p = strtok (NULL, ","))
+    {
+      int level;
+      for (level = 0; level < N_LEVELS; level++)
+	if (!strcmp (p, level_name (level)))
+	  break;
+      if (level == N_LEVELS)
+	usage ();
+      levels |= 1 << level;
+    }
+
+  return levels;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct export_options opts;
+  FILE *out = stdout;
+  struct tm tm;
+  time_t end;
+  int first_year, use_tables = 0;
+  int c;
+
+  memset (&opts, 0, sizeof (opts));
+  opts.format = EXPORT_GEOJSON;
+  opts.levels = (1 << N_LEVELS) - 1;
+  opts.resolution = 1.0;
+  opts.count = 1;
+  opts.step = 60;
+
+  while ((c = getopt (argc, argv, "bel:n:s:r:o:")) != -1)
+    switch (c)
+      {
+      case 'b':
+	opts.format = EXPORT_BINARY;
+	break;
+      case 'e':
+	use_tables = 1;
+	break;
+      case 'l':
+	opts.levels = parse_levels (optarg);
+	break;
+      case 'n':
+	opts.count = atol (optarg);
+	if (opts.count <= 0)
+	  usage ();
+	break;
+      case 's':
+	opts.step = atol (optarg) * 60;
+	if (opts.step <= 0)
+	  usage ();
+	break;
+      case 'r':
+	opts.resolution = atof (optarg);
+	if (opts.resolution < 0.05 || opts.resolution > 45.0)
+	  usage ();
+	break;
+      case 'o':
+	out = fopen (optarg, "wb");
+	if (!out)
+	  {
+	    perror (optarg);
+	    exit (1);
+	  }
+	break;
+      default:
+	usage ();
+      }
+
+  if (argc - optind != 1)
+    usage ();
+
+  memset (&tm, 0, sizeof (tm));
+  if (sscanf (argv[optind], "%d-%d-%dT%d:%d", &tm.tm_year, &tm.tm_mon,
+	      &tm.tm_mday, &tm.tm_hour, &tm.tm_min) < 3)
+    usage ();
+
+  first_year = tm.tm_year;
+  tm.tm_year -= 1900;
+  tm.tm_mon--;
+  opts.start = timegm (&tm);
+
+  if (use_tables)
+    {
+      end = opts.start + (opts.count - 1) * opts.step;
+      gmtime_r (&end, &tm);
+      if (ephem_init (first_year, tm.tm_year + 1900) != 0)
+	{
+	  fprintf (stderr, "terminator-export: cannot build ephemeris tables\n");
+	  exit (1);
+	}
+    }
+
+  if (export_terminators (out, &opts) != 0)
+    {
+      perror ("terminator-export");
+      exit (1);
+    }
+
+  return 0;
+}
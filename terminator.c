@@ -0,0 +1,855 @@
+/* Day/night boundary tracing.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "contour.h"
+#include "terminator.h"
+
+/* State that is carried from one trace to the next.
+
+   Sunrise and sunset times only depend on the date and on the position,
+   so they are cached for every point of the grid until the date changes.
+   Points whose cache entry is valid have STAMP equal to CUR_STAMP.
+
+   The terminator also moves by less than a cell between traces when
+   they are close in time, so most of the ring does not change from one
+   trace to the next.  The ring is kept together with the marching
+   squares case of each cell, and with the time until which that case
+   is known to stay the same: this is the first sunrise or sunset, at
+   any of the cell's corners, that comes after the time of the trace.
+   The next trace starts from a boundary cell close to where the last
+   one started, and copies the cells whose case cannot have changed;
+   only the others are evaluated again (see retrace_ring).
+
+   The shape of the lit part changes when all the points on the border
+   of the grid become lit, or stop being lit (see the comment in
+   trace_terminator), so a full trace is done in that case.  Whether the
+   border is all lit is also remembered until it may change.  */
+
+struct terminator
+{
+  sun_rise_set_fn *f;
+  int width, height;
+  double *lon, *lat;
+  int parallel;
+
+  /* Set while contour_trace_tiles runs; the cache is then only read,
+     because several threads use it.  */
+  int shared;
+
+  int year, month, day;
+  double hours;
+  int date_valid;
+
+  unsigned short cur_stamp;
+  unsigned short *stamp;
+  signed char *rc;
+  double *rise, *set;
+
+  int seed_valid;
+  int seed_x, seed_y;
+
+  /* How many points are outside the grid on each side; the trace
+     walks in from the left of this border.  */
+  int border;
+  int max_steps;
+
+  /* The ring that starts at the seed, traced with RING_FN at RING_HOURS,
+     and the space for the next one.  No cell of the ring can change
+     before RING_MIN_UNTIL.  If RING_KNOWN is zero, the cases were not
+     computed and all the cells are taken to have changed.  */
+  contour_fn *ring_fn;
+  struct contour_point *ring, *new_ring;
+  unsigned char *ring_case, *new_case;
+  double *ring_until, *new_until;
+  int ring_len, ring_max, ring_known;
+  double ring_hours, ring_min_until;
+
+  /* The time between traces from which, on this date, the ring is
+     walked like marching_squares does because most of its cells
+     change.  */
+  double walk_hours;
+
+  /* Whether the last full trace found a dark hole, in which case the
+     ring is the hole and OUTER is the rectangle around it; and whether
+     the border was all lit then.  */
+  int hole, hole_border_lit;
+  struct contour outer;
+
+  /* Whether the border was all lit at BORDER_HOURS; this cannot change
+     before BORDER_UNTIL.  */
+  int border_valid, border_lit;
+  double border_hours, border_until;
+
+  struct contour contour;
+};
+
+/* How far from the previous starting cell we look for the contour.  */
+#define TRACK_RADIUS 8
+
+struct terminator *
+new_terminator (sun_rise_set_fn *f, int width, int height,
+		const double *lon, const double *lat)
+{
+  struct terminator *tr = calloc (1, sizeof (struct terminator));
+  int n = width * height;
+
+  if (!tr)
+    abort ();
+
+  tr->f = f;
+  tr->width = width;
+  tr->height = height;
+  tr->lon = malloc (width * sizeof (double));
+  tr->lat = malloc (height * sizeof (double));
+  tr->stamp = calloc (n, sizeof (unsigned short));
+  tr->rc = malloc (n * sizeof (signed char));
+  tr->rise = malloc (n * sizeof (double));
+  tr->set = malloc (n * sizeof (double));
+  if (!tr->lon || !tr->lat || !tr->stamp || !tr->rc || !tr->rise || !tr->set)
+    abort ();
+
+  memcpy (tr->lon, lon, width * sizeof (double));
+  memcpy (tr->lat, lat, height * sizeof (double));
+
+  /* A trace that starts away from the contour can end up in a loop that
+     does not include the starting cell.  No closed contour can be longer
+     than the number of cells in the grid and its border.  */
+  tr->border = 6;
+  tr->max_steps = (width + 2 * tr->border) * (height + 2 * tr->border);
+  return tr;
+}
+
+void
+free_terminator (struct terminator *tr)
+{
+  contour_free (&tr->contour);
+  contour_free (&tr->outer);
+  free (tr->ring);
+  free (tr->new_ring);
+  free (tr->ring_case);
+  free (tr->new_case);
+  free (tr->ring_until);
+  free (tr->new_until);
+  free (tr->lon);
+  free (tr->lat);
+  free (tr->stamp);
+  free (tr->rc);
+  free (tr->rise);
+  free (tr->set);
+  free (tr);
+}
+
+void
+terminator_set_parallel (struct terminator *tr, int parallel)
+{
+  tr->parallel = parallel;
+}
+
+static void
+set_date (struct terminator *tr, int year, int month, int day)
+{
+  if (tr->date_valid
+      && tr->year == year && tr->month == month && tr->day == day)
+    return;
+
+  tr->year = year;
+  tr->month = month;
+  tr->day = day;
+  tr->date_valid = 1;
+  tr->seed_valid = 0;
+  tr->border_valid = 0;
+  tr->walk_hours = HUGE_VAL;
+
+  /* Invalidate all the cached times.  */
+  if (++tr->cur_stamp == 0)
+    {
+      memset (tr->stamp, 0,
+	      tr->width * tr->height * sizeof (unsigned short));
+      tr->cur_stamp = 1;
+    }
+}
+
+static double
+point_lon (struct terminator *tr, int x)
+{
+  int w = tr->width;
+
+  if (x < 0)
+    return tr->lon[0] + x * (tr->lon[1] - tr->lon[0]);
+  if (x >= w)
+    return tr->lon[w - 1] + (x - w + 1) * (tr->lon[w - 1] - tr->lon[w - 2]);
+  return tr->lon[x];
+}
+
+static double
+point_lat (struct terminator *tr, int y)
+{
+  int h = tr->height;
+
+  if (y < 0)
+    return tr->lat[0] + y * (tr->lat[1] - tr->lat[0]);
+  if (y >= h)
+    return tr->lat[h - 1] + (y - h + 1) * (tr->lat[h - 1] - tr->lat[h - 2]);
+  return tr->lat[y];
+}
+
+/* Get the sunrise and sunset times at X, Y, from the cache if they
+   are in the grid.  */
+static inline int
+point_times (struct terminator *tr, int x, int y, double *rise, double *set)
+{
+  if (x >= 0 && x < tr->width && y >= 0 && y < tr->height)
+    {
+      int i = y * tr->width + x;
+      if (tr->stamp[i] != tr->cur_stamp)
+	{
+	  if (tr->shared)
+	    return tr->f (tr->year, tr->month, tr->day,
+			  tr->lon[x], tr->lat[y], rise, set);
+
+	  tr->rc[i] = tr->f (tr->year, tr->month, tr->day,
+			     tr->lon[x], tr->lat[y],
+			     &tr->rise[i], &tr->set[i]);
+	  tr->stamp[i] = tr->cur_stamp;
+	}
+
+      *rise = tr->rise[i];
+      *set = tr->set[i];
+      return tr->rc[i];
+    }
+  else
+    return tr->f (tr->year, tr->month, tr->day,
+		  point_lon (tr, x), point_lat (tr, y), rise, set);
+}
+
+static inline int has_daylight (int x, int y, void *data)
+{
+  struct terminator *tr = (struct terminator *) data;
+  double rise, set;
+  double hm = tr->hours;
+
+  switch (point_times (tr, x, y, &rise, &set))
+    {
+    case -1:
+      return 0;
+    case 1:
+      return 1;
+    default:
+      return ((hm > rise && hm < set)
+	      || (hm + 24 > rise && hm + 24 < set)
+	      || (hm - 24 > rise && hm - 24 < set));
+    }
+}
+
+/* Move X, Y to the point of the grid whose value inside uses, or
+   return 0 if inside is always false there.  */
+static inline int
+clamp_point (struct terminator *tr, int *x, int *y)
+{
+  int b = tr->border - 1;
+
+  if (*y < -b || *y >= tr->height + b || *x < -b || *x >= tr->width + b)
+    return 0;
+
+  if (*y < 0)
+    *y = 0;
+  if (*y >= tr->height)
+    *y = tr->height - 1;
+
+  if (*x < 0)
+    *x = 0;
+  if (*x >= tr->width)
+    *x = tr->width - 1;
+
+  return 1;
+}
+
+static int inside (int x, int y, void *data)
+{
+  struct terminator *tr = (struct terminator *) data;
+
+  return clamp_point (tr, &x, &y) && has_daylight (x, y, data);
+}
+
+/* Return has_daylight at X, Y, and store in *UNTIL the first time, not
+   earlier than the current one, at which it may change.  */
+static inline int
+daylight_until (struct terminator *tr, int x, int y, double *until)
+{
+  double rise, set, hm = tr->hours, t[6], u;
+  int i;
+
+  switch (point_times (tr, x, y, &rise, &set))
+    {
+    case -1:
+      *until = HUGE_VAL;
+      return 0;
+    case 1:
+      *until = HUGE_VAL;
+      return 1;
+    }
+
+  /* This is called for every new point of the ring, so avoid branches
+     that are hard to predict.  */
+  t[0] = rise - 24, t[1] = rise, t[2] = rise + 24;
+  t[3] = set - 24, t[4] = set, t[5] = set + 24;
+  *until = HUGE_VAL;
+  for (i = 0; i < 6; i++)
+    {
+      u = t[i] >= hm ? t[i] : HUGE_VAL;
+      *until = u < *until ? u : *until;
+    }
+
+  return (((hm > rise) & (hm < set))
+	  | ((hm + 24 > rise) & (hm + 24 < set))
+	  | ((hm - 24 > rise) & (hm - 24 < set)));
+}
+
+/* The corners of a cell in the same order as the bits of its marching
+   squares case, from the top left (bit 3) to the bottom right (bit 0),
+   and the time at which each of them may change.  */
+struct cell
+{
+  int x, y;
+  int lit[4];
+  double until[4];
+};
+
+/* Evaluate the corners of the cell whose top left corner is X, Y with
+   the ring's function, taking those that it shares with PREV from there
+   if PREV is not NULL.  Return its case and store in *UNTIL the first
+   time at which it may change.  */
+static int
+ring_cell (struct terminator *tr, struct cell *c, int x, int y,
+	   const struct cell *prev, double *until)
+{
+  int cell = 0, i;
+
+  c->x = x;
+  c->y = y;
+  *until = HUGE_VAL;
+  for (i = 0; i < 4; i++)
+    {
+      int px = x + (i & 1), py = y + (i >> 1);
+      int dx = prev ? px - prev->x : -1, dy = prev ? py - prev->y : -1;
+
+      if (dx >= 0 && dx <= 1 && dy >= 0 && dy <= 1)
+	{
+	  c->lit[i] = prev->lit[dy * 2 + dx];
+	  c->until[i] = prev->until[dy * 2 + dx];
+	}
+      else if (tr->ring_fn == inside && !clamp_point (tr, &px, &py))
+	{
+	  c->lit[i] = 0;
+	  c->until[i] = HUGE_VAL;
+	}
+      else
+	c->lit[i] = daylight_until (tr, px, py, &c->until[i]);
+
+      if (c->lit[i])
+	cell |= 8 >> i;
+      if (c->until[i] < *until)
+	*until = c->until[i];
+    }
+
+  return cell;
+}
+
+/* Fill C with the corners of the cell at X, Y, given its case CELL and
+   the time UNTIL at which it may change.  That time is not later than
+   the one of each corner, so it is a safe answer for all of them.  */
+static void
+known_cell (struct cell *c, int x, int y, int cell, double until)
+{
+  int i;
+
+  c->x = x;
+  c->y = y;
+  for (i = 0; i < 4; i++)
+    {
+      c->lit[i] = (cell >> (3 - i)) & 1;
+      c->until[i] = until;
+    }
+}
+
+/* Return whether all the points on the border of the grid have
+   daylight.  If they do, the answer holds until the first of them
+   changes; if they do not, it holds as long as the point that stays
+   dark the longest does not change.  */
+static int
+border_lit (struct terminator *tr)
+{
+  int w = tr->width, h = tr->height;
+  double all_until = HUGE_VAL, dark_until = -HUGE_VAL;
+  int i, n = 2 * (w + h) - 4;
+
+  if (tr->border_valid && tr->hours >= tr->border_hours
+      && tr->hours < tr->border_until)
+    return tr->border_lit;
+
+  for (i = 0; i < n; i++)
+    {
+      int x, y;
+      double u;
+
+      if (i < w)
+	x = i, y = 0;
+      else if (i < 2 * w)
+	x = i - w, y = h - 1;
+      else if (i < 2 * w + h - 2)
+	x = 0, y = i - 2 * w + 1;
+      else
+	x = w - 1, y = i - (2 * w + h - 2) + 1;
+
+      if (daylight_until (tr, x, y, &u))
+	{
+	  if (u < all_until)
+	    all_until = u;
+	}
+      else if (u > dark_until)
+	dark_until = u;
+    }
+
+  tr->border_valid = 1;
+  tr->border_lit = dark_until == -HUGE_VAL;
+  tr->border_hours = tr->hours;
+  tr->border_until = tr->border_lit ? all_until : dark_until;
+  return tr->border_lit;
+}
+
+#define BAD -151515151
+
+static void
+grow_ring (struct terminator *tr, int n)
+{
+  if (n <= tr->ring_max)
+    return;
+
+  tr->ring_max = tr->ring_max ? tr->ring_max * 2 : 1024;
+  if (tr->ring_max < n)
+    tr->ring_max = n;
+
+  tr->ring = realloc (tr->ring, tr->ring_max * sizeof (struct contour_point));
+  tr->new_ring = realloc (tr->new_ring,
+			  tr->ring_max * sizeof (struct contour_point));
+  tr->ring_case = realloc (tr->ring_case, tr->ring_max);
+  tr->new_case = realloc (tr->new_case, tr->ring_max);
+  tr->ring_until = realloc (tr->ring_until, tr->ring_max * sizeof (double));
+  tr->new_until = realloc (tr->new_until, tr->ring_max * sizeof (double));
+  if (!tr->ring || !tr->new_ring || !tr->ring_case || !tr->new_case
+      || !tr->ring_until || !tr->new_until)
+    abort ();
+}
+
+/* Return the index of the first cell of the ring from I on, wrapping
+   around, whose case cannot have changed; -1 if there is none.  */
+static int
+next_unchanged (struct terminator *tr, int i)
+{
+  int n;
+
+  for (n = 0; n < tr->ring_len; n++, i++)
+    {
+      if (i == tr->ring_len)
+	i = 0;
+      if (tr->ring_until[i] > tr->hours)
+	return i;
+    }
+
+  return -1;
+}
+
+/* Remember the first N points of PTS, traced with FN, as the ring.  */
+static void
+save_ring (struct terminator *tr, const struct contour_point *pts, int n,
+	   contour_fn *fn)
+{
+  struct cell cells[2];
+  int i;
+
+  grow_ring (tr, n);
+  tr->ring_fn = fn;
+  tr->ring_min_until = HUGE_VAL;
+  for (i = 0; i < n; i++)
+    {
+      tr->ring[i] = pts[i];
+      tr->ring_case[i] = ring_cell (tr, &cells[i & 1], pts[i].x, pts[i].y,
+				    i ? &cells[~i & 1] : NULL,
+				    &tr->ring_until[i]);
+      if (tr->ring_until[i] < tr->ring_min_until)
+	tr->ring_min_until = tr->ring_until[i];
+    }
+
+  tr->ring_len = n;
+  tr->ring_known = 1;
+  tr->ring_hours = tr->hours;
+  tr->seed_x = pts[0].x;
+  tr->seed_y = pts[0].y;
+  tr->seed_valid = n > 0;
+}
+
+/* Start loading the points around the cells of the ring whose case
+   may have changed.  These have often not been looked at for several
+   traces, and loading them all at once is faster than waiting for each
+   as the ring is traced.  The contour moves by less than a cell, so
+   the new cells are among the ones loaded here.  */
+static void
+prefetch_changed (struct terminator *tr)
+{
+  int i, x, y;
+
+  for (i = 0; i < tr->ring_len; i++)
+    if (tr->ring_until[i] <= tr->hours)
+      {
+	x = tr->ring[i].x;
+	if (x < 1)
+	  x = 1;
+	if (x > tr->width - 3)
+	  x = tr->width - 3;
+
+	/* Columns X - 1 to X + 2 of the two rows of the cell.  */
+	for (y = tr->ring[i].y; y <= tr->ring[i].y + 1; y++)
+	  if (y >= 0 && y < tr->height)
+	    {
+	      int j = y * tr->width + x - 1;
+	      __builtin_prefetch (&tr->rise[j]);
+	      __builtin_prefetch (&tr->rise[j + 3]);
+	      __builtin_prefetch (&tr->set[j]);
+	      __builtin_prefetch (&tr->set[j + 3]);
+	    }
+      }
+}
+
+/* Trace the ring that goes through the cell X, Y, using the previous
+   ring for the cells whose case cannot have changed since it was traced.
+   Since the case of a cell determines the next one, a cell that did not
+   change is followed by the same one as in the previous ring, and so
+   the whole run of unchanged cells that starts there can be copied.
+   The other cells are traced like marching_squares does, until the
+   trace reaches the first unchanged cell that follows them in the
+   previous ring (it almost always does; if not, the cells that follow
+   are traced too, which is slower but gives the same result).  START
+   is the index of X, Y in the previous ring, or -1.  Return 1 if this
+   succeeded, 0 if a full trace is needed.  */
+
+static int
+retrace_ring (struct terminator *tr, int sx, int sy, int start)
+{
+  double hm = tr->hours, min_until = HUGE_VAL;
+  int x = sx, y = sy, n = 0, i, j, k;
+  struct cell cells[2], *prev = NULL;
+
+  prefetch_changed (tr);
+  i = start >= 0 && tr->ring_until[start] > hm ? start : -1;
+  k = next_unchanged (tr, start >= 0 ? start : 0);
+  do
+    {
+      if (i >= 0)
+	{
+	  /* Copy up to the first cell that may have changed, or up to
+	     the end of the array.  */
+	  for (j = i; j < tr->ring_len && (j == i || j != start); j++)
+	    {
+	      if (tr->ring_until[j] <= hm)
+		break;
+	      if (tr->ring_until[j] < min_until)
+		min_until = tr->ring_until[j];
+	    }
+
+	  grow_ring (tr, n + j - i);
+	  memcpy (tr->new_ring + n, tr->ring + i,
+		  (j - i) * sizeof (struct contour_point));
+	  memcpy (tr->new_case + n, tr->ring_case + i, j - i);
+	  memcpy (tr->new_until + n, tr->ring_until + i,
+		  (j - i) * sizeof (double));
+	  n += j - i;
+
+	  /* The corners that the next cell shares with the last one that
+	     was copied are known from the case of the latter.  */
+	  prev = &cells[0];
+	  known_cell (prev, tr->new_ring[n - 1].x, tr->new_ring[n - 1].y,
+		      tr->new_case[n - 1], tr->new_until[n - 1]);
+
+	  if (j == tr->ring_len)
+	    j = 0;
+	  x = tr->ring[j].x;
+	  y = tr->ring[j].y;
+	  if (j != start && tr->ring_until[j] > hm)
+	    i = j;
+	  else
+	    {
+	      i = -1;
+	      k = next_unchanged (tr, j);
+	    }
+	}
+      else
+	{
+	  /* Trace this cell like marching_squares, reusing the corners
+	     that it shares with the previous one.  */
+	  struct cell *c = prev == &cells[0] ? &cells[1] : &cells[0];
+	  double until;
+	  int cell = ring_cell (tr, c, x, y, prev, &until);
+	  if (cell == 0 || cell == 15)
+	    return 0;
+
+	  prev = c;
+	  if (until < min_until)
+	    min_until = until;
+
+	  grow_ring (tr, n + 1);
+	  tr->new_ring[n].x = x;
+	  tr->new_ring[n].y = y;
+	  tr->new_case[n] = cell;
+	  tr->new_until[n] = until;
+	  n++;
+	  contour_next (cell, &x, &y);
+	  if (k >= 0 && x == tr->ring[k].x && y == tr->ring[k].y)
+	    i = k;
+	}
+
+      if (n >= tr->max_steps)
+	return 0;
+    }
+  while (x != sx || y != sy);
+
+  /* Like marching_squares, refuse a ring that never enters the grid,
+     unless it is the hole.  */
+  if (!tr->hole)
+    {
+      for (i = 0; i < n; i++)
+	if (tr->new_ring[i].x >= 0 && tr->new_ring[i].x < tr->width
+	    && tr->new_ring[i].y >= 0 && tr->new_ring[i].y < tr->height)
+	  break;
+      if (i == n)
+	return 0;
+    }
+
+#define SWAP(a, b) do { void *t_ = (a); (a) = (b); (b) = t_; } while (0)
+  SWAP (tr->ring, tr->new_ring);
+  SWAP (tr->ring_case, tr->new_case);
+  SWAP (tr->ring_until, tr->new_until);
+#undef SWAP
+  tr->ring_len = n;
+  tr->ring_known = 1;
+  tr->ring_hours = hm;
+  tr->ring_min_until = min_until;
+  return 1;
+}
+
+/* Trace the ring from the cell X, Y with marching_squares, and keep it
+   without the cases of its cells.  Return 1 if this succeeded, 0 if a
+   full trace is needed.  */
+
+static int
+walk_ring (struct terminator *tr, int x, int y)
+{
+  struct contour *c = &tr->contour;
+  int first, n, i;
+
+  if (tr->hole)
+    contour_add_ring (c, tr->outer.pts, tr->outer.n_pts);
+
+  first = c->n_pts;
+  if (marching_squares (c, tr->width, tr->height, x, y, tr->ring_fn, tr,
+			tr->max_steps) != 1)
+    {
+      contour_clear (c);
+      return 0;
+    }
+
+  n = c->n_pts - first;
+  grow_ring (tr, n);
+  memcpy (tr->ring, c->pts + first, n * sizeof (struct contour_point));
+  for (i = 0; i < n; i++)
+    tr->ring_until[i] = -HUGE_VAL;
+
+  tr->ring_len = n;
+  tr->ring_known = 0;
+  tr->ring_hours = tr->hours;
+  tr->ring_min_until = -HUGE_VAL;
+  return 1;
+}
+
+/* Look for a boundary cell near where the previous trace started
+   and, if one is found, trace the contour again from there.  Return 1
+   if this succeeded, 0 if a full trace is needed.  */
+
+static int
+track_contour (struct terminator *tr)
+{
+  int i, n, walk, x = BAD, start = -1;
+
+  if (!tr->seed_valid || tr->hours < tr->ring_hours)
+    return 0;
+
+  /* Unless the border stays all lit or not, there is exactly one ring,
+     or exactly the same rectangle with one hole in it.  */
+  if (border_lit (tr) != tr->hole_border_lit)
+    return 0;
+
+  /* If no cell can have changed, neither did the ring.  */
+  if (tr->hours == tr->ring_hours || tr->hours < tr->ring_min_until)
+    goto done;
+
+  /* Tracing a cell again costs about three times as much as walking
+     past it, so if more than a third of them changed, walk the ring
+     instead.  Then keep doing so until the traces get twice as close
+     in time.  */
+  if (tr->ring_known)
+    {
+      for (i = n = 0; i < tr->ring_len; i++)
+	n += tr->ring_until[i] <= tr->hours;
+      walk = 3 * n > tr->ring_len;
+      if (walk)
+	tr->walk_hours = tr->hours - tr->ring_hours;
+    }
+  else
+    walk = 2 * (tr->hours - tr->ring_hours) > tr->walk_hours;
+
+  /* The ring starts at the seed.  If its case did not change, it is
+     still a boundary cell and there is no need to look for one.  */
+  if (tr->ring_until[0] > tr->hours)
+    x = tr->seed_x, start = 0;
+  else
+    for (i = 0; i <= TRACK_RADIUS; i++)
+      {
+	if (contour_boundary_cell (tr->seed_x + i, tr->seed_y,
+				   tr->ring_fn, tr))
+	  {
+	    x = tr->seed_x + i;
+	    break;
+	  }
+	if (i && contour_boundary_cell (tr->seed_x - i, tr->seed_y,
+					tr->ring_fn, tr))
+	  {
+	    x = tr->seed_x - i;
+	    break;
+	  }
+      }
+
+  if (x == BAD)
+    return 0;
+
+  if (walk)
+    {
+      if (!walk_ring (tr, x, tr->seed_y))
+	return 0;
+
+      tr->seed_x = x;
+      return 1;
+    }
+
+  if (start < 0)
+    for (i = 0; i < tr->ring_len; i++)
+      if (tr->ring[i].x == x && tr->ring[i].y == tr->seed_y)
+	{
+	  start = i;
+	  break;
+	}
+
+  if (!retrace_ring (tr, x, tr->seed_y, start))
+    return 0;
+
+  tr->seed_x = x;
+
+ done:
+  if (tr->hole)
+    contour_add_ring (&tr->contour, tr->outer.pts, tr->outer.n_pts);
+  contour_add_ring (&tr->contour, tr->ring, tr->ring_len);
+  return 1;
+}
+
+/* Trace the contour starting from X, Y.  In parallel mode, FN does
+   not write to TR while the tiles are classified; the cache is filled
+   again along the ring by the next traces.  */
+
+static int
+trace_contour (struct terminator *tr, int x, int y,
+	       contour_fn *fn, int border)
+{
+  int rc = -1;
+
+  if (tr->parallel)
+    {
+      tr->shared = 1;
+      rc = contour_trace_tiles (&tr->contour, tr->width, tr->height,
+				-border, -border,
+				tr->width - 1 + border,
+				tr->height - 1 + border,
+				x < -border ? -border : x, y, fn, tr);
+      tr->shared = 0;
+    }
+
+  if (rc == -1)
+    rc = marching_squares (&tr->contour, tr->width, tr->height, x, y,
+			   fn, tr, 0);
+  return rc;
+}
+
+void
+trace_terminator (struct terminator *tr, int year, int month, int day,
+		  double hours, struct contour *c)
+{
+  int equator = tr->height / 2;
+
+  set_date (tr, year, month, day);
+  tr->hours = hours;
+  contour_clear (&tr->contour);
+
+  /* This is a little hackish.  Sometime the civil twilight's shape is
+     a rectangle with a "hole" in it.  In this case, several interesting
+     things happen:
+
+     1) we know that the first marching squares pass will trace a rectangle,
+        because it will just go around the borders
+
+     2) however, we know that we can trace the hole, if we start *inside*
+        the map (i.e.  inside the lit part!) and we don't consider the
+        borders at all.
+
+     3) we know that both the rectangle and the hole are traced in the
+        same direction, so that the if we trace both the even/odd rule
+        will indeed generate a rectangle with a hole:
+
+                             .----.
+                            |2222222|
+                 .----------+-2-2-2-+----.
+                 |1111111111|2222222|1111.
+                 |1111111111|2222222|1111.
+                 |1111111111'-------'1111.
+                 |11111111111111111111111.
+                 '-----------------------'
+
+     So marching_squares returns false if it never enters the map, and in
+     this case we call it again with a slightly different function that will
+     trace the inside shape without regards for border.  */
+
+  if (!track_contour (tr))
+    {
+      struct contour *ct = &tr->contour;
+
+      tr->hole = !trace_contour (tr, -10 * tr->border, equator,
+				 inside, tr->border);
+      tr->hole_border_lit = border_lit (tr);
+      if (!tr->hole)
+	save_ring (tr, ct->pts, ct->n_pts, inside);
+      else
+	{
+	  contour_clear (&tr->outer);
+	  contour_add_ring (&tr->outer, ct->pts, ct->n_pts);
+	  trace_contour (tr, 3, equator, has_daylight, 0);
+	  save_ring (tr, ct->pts + ct->rings[1], ct->n_pts - ct->rings[1],
+		     has_daylight);
+	}
+    }
+
+  contour_copy (c, &tr->contour);
+}
@@ -0,0 +1,39 @@
+/* Day/night boundary tracing interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef TERMINATOR_H
+#define TERMINATOR_H
+
+#include "contour.h"
+
+typedef int sun_rise_set_fn (int, int, int, double, double, double *, double *);
+
+/* State used to trace the boundary of the region where the Sun is up,
+   according to F, efficiently from one call to the next.  The grid has
+   WIDTH x HEIGHT points; the point X, Y is at longitude LON[X] and
+   latitude LAT[Y], and latitudes go from north to south.  Points outside
+   the grid are placed by extending the first and last steps of LON and
+   LAT.  The arrays are copied.  */
+struct terminator;
+
+extern struct terminator *new_terminator (sun_rise_set_fn *f,
+					  int width, int height,
+					  const double *lon, const double *lat);
+extern void free_terminator (struct terminator *);
+
+/* Set whether full traces evaluate the whole grid first, with all the
+   threads of parallel_for.  This is off by default, and must be off if
+   the tracer itself runs inside parallel_for.  */
+extern void terminator_set_parallel (struct terminator *, int parallel);
+
+/* Trace the boundary at HOURS UT of the given day, and store it in C.
+   The points of C are the top left corners of the cells that the
+   boundary crosses, and can be up to 6 cells outside the grid.  Each
+   ring goes around the lit part, or around a dark hole in it.  */
+extern void trace_terminator (struct terminator *, int year, int month,
+			      int day, double hours, struct contour *c);
+
+#endif /* TERMINATOR_H */
@@ -0,0 +1,331 @@
+/* Video output module.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "video.h"
+
+/* Frames are converted by the caller into one of two buffers, and a
+   writer thread sends them to the file descriptor.  This way the next
+   frame is rendered while the previous one is written; when the reader
+   of a pipe is slower than us, video_write_frame waits for a buffer to
+   be free, so that no more than two frames are ever kept in memory.  */
+
+#define VIDEO_BUFFERS 2
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_t writer_thread;
+
+/* Buffers HEAD to HEAD + COUNT - 1 are waiting to be written.  */
+static unsigned char *buffers[VIDEO_BUFFERS];
+static int head, count;
+static int closing;
+
+/* The errno of the first write that failed, or 0.  */
+static int failed;
+
+static int out_fd;
+static enum video_format out_format;
+static int out_width, out_height;
+static size_t frame_header, frame_size;
+
+
+/* The conversion to YUV uses the BT.601 coefficients with 8 bits of
+   precision, giving "studio range" values like most encoders expect.
+   Chroma is the average of each 2x2 block of pixels, which matches the
+   centered chroma position of Y4M's default 4:2:0 format.  Cairo's
+   ARGB32 format uses premultiplied alpha, but our frames are opaque so
+   alpha is ignored.
+
+   The macros work on both integers and vectors; the chroma macros take
+   the sum of 1 << S pixels.  */
+
+#define RED(p)		(((p) >> 16) & 255)
+#define GREEN(p)	(((p) >> 8) & 255)
+#define BLUE(p)		((p) & 255)
+
+#define LUMA(r, g, b) \
+  (((66 * (r) + 129 * (g) + 25 * (b) + 128) >> 8) + 16)
+#define CHROMA_U(r, g, b, s) \
+  (((-38 * (r) - 74 * (g) + 112 * (b) + (128 << (s))) >> (8 + (s))) + 128)
+#define CHROMA_V(r, g, b, s) \
+  (((112 * (r) - 94 * (g) - 18 * (b) + (128 << (s))) >> (8 + (s))) + 128)
+
+/* Like degtrig.c, use GCC's generic vectors.  */
+
+#ifdef __AVX2__
+#define VLEN 8
+#define EVEN ((vint) { 0, 2, 4, 6, 8, 10, 12, 14 })
+#define ODD ((vint) { 1, 3, 5, 7, 9, 11, 13, 15 })
+#else
+#define VLEN 4
+#define EVEN ((vint) { 0, 2, 4, 6 })
+#define ODD ((vint) { 1, 3, 5, 7 })
+#endif
+
+typedef int32_t vint __attribute__ ((vector_size (VLEN * sizeof (int32_t))));
+typedef uint8_t vbyte __attribute__ ((vector_size (VLEN)));
+
+static inline vint
+vload (const uint32_t *p)
+{
+  vint v;
+  memcpy (&v, p, sizeof (v));
+  return v;
+}
+
+static inline void
+vstore (uint8_t *p, vint v)
+{
+  vbyte b = __builtin_convertvector (v, vbyte);
+  memcpy (p, &b, sizeof (b));
+}
+
+static void
+convert_luma (const uint32_t *src, uint8_t *dst, int width)
+{
+  int x;
+
+  for (x = 0; x + VLEN <= width; x += VLEN)
+    {
+      vint p = vload (src + x);
+      vstore (dst + x, LUMA (RED (p), GREEN (p), BLUE (p)));
+    }
+
+  for (; x < width; x++)
+    dst[x] = LUMA (RED (src[x]), GREEN (src[x]), BLUE (src[x]));
+}
+
+/* Compute the chroma of the pixels in rows SRC0 and SRC1.  */
+static void
+convert_chroma (const uint32_t *src0, const uint32_t *src1,
+		uint8_t *u, uint8_t *v, int width)
+{
+  int x;
+
+  for (x = 0; x + 2 * VLEN <= width; x += 2 * VLEN)
+    {
+      vint a0 = vload (src0 + x), b0 = vload (src0 + x + VLEN);
+      vint a1 = vload (src1 + x), b1 = vload (src1 + x + VLEN);
+      vint e0 = __builtin_shuffle (a0, b0, EVEN);
+      vint o0 = __builtin_shuffle (a0, b0, ODD);
+      vint e1 = __builtin_shuffle (a1, b1, EVEN);
+      vint o1 = __builtin_shuffle (a1, b1, ODD);
+      vint r = RED (e0) + RED (o0) + RED (e1) + RED (o1);
+      vint g = GREEN (e0) + GREEN (o0) + GREEN (e1) + GREEN (o1);
+      vint b = BLUE (e0) + BLUE (o0) + BLUE (e1) + BLUE (o1);
+      vstore (u + x / 2, CHROMA_U (r, g, b, 2));
+      vstore (v + x / 2, CHROMA_V (r, g, b, 2));
+    }
+
+  for (; x < width; x += 2)
+    {
+      uint32_t p0 = src0[x], p1 = src0[x + 1];
+      uint32_t p2 = src1[x], p3 = src1[x + 1];
+      int r = RED (p0) + RED (p1) + RED (p2) + RED (p3);
+      int g = GREEN (p0) + GREEN (p1) + GREEN (p2) + GREEN (p3);
+      int b = BLUE (p0) + BLUE (p1) + BLUE (p2) + BLUE (p3);
+      u[x / 2] = CHROMA_U (r, g, b, 2);
+      v[x / 2] = CHROMA_V (r, g, b, 2);
+    }
+}
+
+static void
+convert_yuv420 (const uint32_t *argb, int stride, unsigned char *dst)
+{
+  unsigned char *y = dst;
+  unsigned char *u = y + out_width * out_height;
+  unsigned char *v = u + (out_width / 2) * (out_height / 2);
+  int i;
+
+  for (i = 0; i < out_height; i += 2)
+    {
+      const uint32_t *row0 = (const uint32_t *) ((const char *) argb
+						 + i * stride);
+      const uint32_t *row1 = (const uint32_t *) ((const char *) row0
+						 + stride);
+      convert_luma (row0, y + i * out_width, out_width);
+      convert_luma (row1, y + (i + 1) * out_width, out_width);
+      convert_chroma (row0, row1, u + (i / 2) * (out_width / 2),
+		      v + (i / 2) * (out_width / 2), out_width);
+    }
+}
+
+static void
+convert_rgb (const uint32_t *argb, int stride, unsigned char *dst)
+{
+  int i, x;
+
+  for (i = 0; i < out_height; i++)
+    {
+      const uint32_t *row = (const uint32_t *) ((const char *) argb
+						+ i * stride);
+      for (x = 0; x < out_width; x++, dst += 3)
+	{
+	  dst[0] = RED (row[x]);
+	  dst[1] = GREEN (row[x]);
+	  dst[2] = BLUE (row[x]);
+	}
+    }
+}
+
+
+static int
+write_all (int fd, const unsigned char *buf, size_t len)
+{
+  while (len > 0)
+    {
+      ssize_t n = write (fd, buf, len);
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+      buf += n;
+      len -= n;
+    }
+
+  return 0;
+}
+
+static void *
+writer (void *arg __attribute__ ((unused)))
+{
+  pthread_mutex_lock (&mutex);
+  for (;;)
+    {
+      unsigned char *buf;
+      int rc;
+
+      while (count == 0 && !closing)
+	pthread_cond_wait (&cond, &mutex);
+      if (count == 0)
+	break;
+
+      /* The caller does not touch queued buffers, so write this one
+	 without holding the lock.  */
+      buf = buffers[head];
+      pthread_mutex_unlock (&mutex);
+
+      rc = failed ? -1 : write_all (out_fd, buf, frame_size);
+
+      pthread_mutex_lock (&mutex);
+      if (rc < 0 && !failed)
+	failed = errno;
+      head = (head + 1) % VIDEO_BUFFERS;
+      count--;
+      pthread_cond_broadcast (&cond);
+    }
+
+  pthread_mutex_unlock (&mutex);
+  return NULL;
+}
+
+int
+video_open (int fd, enum video_format format, int width, int height, int fps)
+{
+  char header[64];
+  int i;
+
+  out_fd = fd;
+  out_format = format;
+  out_width = width;
+  out_height = height;
+  head = count = closing = failed = 0;
+
+  if (format == VIDEO_Y4M)
+    {
+      int n = sprintf (header, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+		       width, height, fps);
+      if (write_all (fd, (unsigned char *) header, n) < 0)
+	return -1;
+
+      frame_header = 6;
+      frame_size = frame_header + width * height
+	+ 2 * (width / 2) * (height / 2);
+    }
+  else
+    {
+      frame_header = 0;
+      frame_size = 3 * width * height;
+    }
+
+  for (i = 0; i < VIDEO_BUFFERS; i++)
+    {
+      buffers[i] = malloc (frame_size);
+      if (!buffers[i])
+	abort ();
+      memcpy (buffers[i], "FRAME\n", frame_header);
+    }
+
+  if (pthread_create (&writer_thread, NULL, writer, NULL) != 0)
+    return -1;
+
+  return 0;
+}
+
+int
+video_write_frame (const uint32_t *argb, int stride)
+{
+  unsigned char *buf;
+
+  pthread_mutex_lock (&mutex);
+  while (count == VIDEO_BUFFERS && !failed)
+    pthread_cond_wait (&cond, &mutex);
+  if (failed)
+    {
+      pthread_mutex_unlock (&mutex);
+      errno = failed;
+      return -1;
+    }
+
+  buf = buffers[(head + count) % VIDEO_BUFFERS];
+  pthread_mutex_unlock (&mutex);
+
+  if (out_format == VIDEO_Y4M)
+    convert_yuv420 (argb, stride, buf + frame_header);
+  else
+    convert_rgb (argb, stride, buf + frame_header);
+
+  pthread_mutex_lock (&mutex);
+  count++;
+  pthread_cond_broadcast (&cond);
+  pthread_mutex_unlock (&mutex);
+  return 0;
+}
+
+int
+video_close (void)
+{
+  int i;
+
+  pthread_mutex_lock (&mutex);
+  closing = 1;
+  pthread_cond_broadcast (&cond);
+  pthread_mutex_unlock (&mutex);
+  pthread_join (writer_thread, NULL);
+
+  for (i = 0; i < VIDEO_BUFFERS; i++)
+    {
+      free (buffers[i]);
+      buffers[i] = NULL;
+    }
+
+  if (failed)
+    {
+      errno = failed;
+      return -1;
+    }
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+/* Video output interface.
+   Paolo Bonzini, August 2008.
+
+   This source code is released for free distribution under the terms
+   of the GNU General Public License.  */
+
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <stdint.h>
+
+enum video_format
+{
+  VIDEO_Y4M,			/* YUV4MPEG2, 4:2:0 */
+  VIDEO_RGB			/* Raw frames, 3 bytes per pixel */
+};
+
+/* Start writing frames of WIDTH x HEIGHT pixels (both even) in the given
+   FORMAT to the file descriptor FD.  FPS is only used in the Y4M
+   header.  Return 0 on success, -1 on failure.  */
+extern int video_open (int fd, enum video_format format,
+		       int width, int height, int fps);
+
+/* Convert the ARGB32 pixels at ARGB, whose rows are STRIDE bytes apart,
+   and queue them for writing.  Wait if the previous frames have not
+   been written yet.  Return -1 with errno set if writing a previous
+   frame failed.  */
+extern int video_write_frame (const uint32_t *argb, int stride);
+
+/* Write the frames that are still queued.  Return 0 if all the frames
+   were written successfully, -1 with errno set otherwise.  */
+extern int video_close (void);
+
+#endif /* VIDEO_H */